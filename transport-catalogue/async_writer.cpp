@@ -0,0 +1,97 @@
+#include "async_writer.h"
+
+AsyncWriter::AsyncWriter(std::ostream& target)
+    : target_(target)
+    , stream_(this) {
+    block_.resize(BLOCK_SIZE);
+    setp(block_.data(), block_.data() + block_.size());
+    worker_ = std::thread([this] { Run(); });
+}
+
+AsyncWriter::~AsyncWriter() {
+    Finish();
+}
+
+void AsyncWriter::Finish() {
+    if (!worker_.joinable()) {
+        return;
+    }
+    SubmitBlock();
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    has_work_.notify_one();
+    worker_.join();
+    target_.flush();
+    if (failed_ || !target_) {
+        stream_.setstate(std::ios_base::badbit);
+    }
+}
+
+AsyncWriter::int_type AsyncWriter::overflow(int_type c) {
+    if (!SubmitBlock()) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int AsyncWriter::sync() {
+    return SubmitBlock() ? 0 : -1;
+}
+
+bool AsyncWriter::SubmitBlock() {
+    const size_t size = static_cast<size_t>(pptr() - pbase());
+    if (size == 0) {
+        return true;
+    }
+    std::string next;
+    {
+        std::unique_lock lock(mutex_);
+        has_room_.wait(lock, [this] { return failed_ || pending_.size() < MAX_PENDING; });
+        if (failed_) {
+            return false;
+        }
+        block_.resize(size);
+        pending_.push(std::move(block_));
+        if (!free_blocks_.empty()) {
+            next = std::move(free_blocks_.back());
+            free_blocks_.pop_back();
+        }
+    }
+    has_work_.notify_one();
+
+    block_ = std::move(next);
+    block_.resize(BLOCK_SIZE);
+    setp(block_.data(), block_.data() + block_.size());
+    return true;
+}
+
+void AsyncWriter::Run() {
+    while (true) {
+        std::string block;
+        {
+            std::unique_lock lock(mutex_);
+            has_work_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;
+            }
+            block = std::move(pending_.front());
+            pending_.pop();
+        }
+
+        target_.write(block.data(), static_cast<std::streamsize>(block.size()));
+        const bool failed = !target_;
+
+        {
+            std::lock_guard lock(mutex_);
+            failed_ = failed_ || failed;
+            free_blocks_.push_back(std::move(block));
+        }
+        has_room_.notify_one();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Поток вывода, запись которого в целевой поток выполняет отдельный поток.
+// Данные копятся блоками по BLOCK_SIZE байт, и заполненный блок уходит писателю:
+// тот, кто печатает ответы, не ждёт записи в файл или канал. В очереди не больше
+// MAX_PENDING блоков, чтобы медленный получатель не накапливал вывод в памяти
+class AsyncWriter : private std::streambuf {
+public:
+    explicit AsyncWriter(std::ostream& target);
+    // Дописывает остаток, как Finish()
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    std::ostream& GetStream() {
+        return stream_;
+    }
+
+    // Отдаёт писателю остаток и ждёт, пока всё окажется в целевом потоке.
+    // Если запись не удалась, у GetStream() выставляется badbit
+    void Finish();
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_PENDING = 16;
+
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+    // Ставит заполненную часть блока в очередь и начинает новый блок
+    bool SubmitBlock();
+    void Run();
+
+    std::ostream& target_;
+    std::ostream stream_;
+    std::string block_;
+
+    std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::condition_variable has_room_;
+    std::queue<std::string> pending_;
+    // Записанные блоки возвращаются сюда, чтобы не выделять память заново
+    std::vector<std::string> free_blocks_;
+    bool stopping_ = false;
+    bool failed_ = false;
+    std::thread worker_;
+};
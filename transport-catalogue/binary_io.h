@@ -0,0 +1,122 @@
+#pragma once
+
+#include "serialization.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace serialization {
+
+    // Примитивы двоичного формата, общие для базы и журнала изменений
+
+    // Накапливает вывод в буфере и сбрасывает его в поток крупными блоками
+    class BinaryWriter {
+    public:
+        explicit BinaryWriter(std::ostream& output) : output_(output) {
+            buffer_.reserve(BUFFER_SIZE);
+        }
+
+        ~BinaryWriter() {
+            Flush();
+        }
+
+        template <typename T>
+        void Write(T value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            const char* bytes = reinterpret_cast<const char*>(&value);
+            buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+            if (buffer_.size() >= BUFFER_SIZE) {
+                Flush();
+            }
+        }
+
+        void WriteSize(size_t size) {
+            if (size > std::numeric_limits<uint32_t>::max()) {
+                throw SerializationError("Array is too large to serialize");
+            }
+            Write(static_cast<uint32_t>(size));
+        }
+
+        void WriteString(std::string_view str) {
+            WriteSize(str.size());
+            buffer_.insert(buffer_.end(), str.begin(), str.end());
+            if (buffer_.size() >= BUFFER_SIZE) {
+                Flush();
+            }
+        }
+
+        void Flush() {
+            output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+            buffer_.clear();
+        }
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+        std::ostream& output_;
+        std::vector<char> buffer_;
+    };
+
+    // Читает значения из буфера с проверкой границ
+    class BinaryReader {
+    public:
+        explicit BinaryReader(std::string_view data) : data_(data) {}
+
+        template <typename T>
+        T Read() {
+            static_assert(std::is_trivially_copyable_v<T>);
+            Require(sizeof(T));
+            T value;
+            std::memcpy(&value, data_.data() + pos_, sizeof(T));
+            pos_ += sizeof(T);
+            return value;
+        }
+
+        size_t ReadSize() {
+            return Read<uint32_t>();
+        }
+
+        // Число элементов, каждый из которых занимает не меньше min_element_size байт.
+        // Проверяется по оставшимся данным, чтобы повреждённый файл не заставил
+        // выделить память под миллиарды элементов
+        size_t ReadCount(size_t min_element_size) {
+            const size_t count = ReadSize();
+            if (count > (data_.size() - pos_) / min_element_size) {
+                throw SerializationError("Element count exceeds serialized data");
+            }
+            return count;
+        }
+
+        std::string_view ReadString() {
+            const size_t size = ReadSize();
+            Require(size);
+            std::string_view result = data_.substr(pos_, size);
+            pos_ += size;
+            return result;
+        }
+
+        bool AtEnd() const {
+            return pos_ == data_.size();
+        }
+
+        size_t GetPosition() const {
+            return pos_;
+        }
+
+    private:
+        void Require(size_t size) const {
+            if (data_.size() - pos_ < size) {
+                throw SerializationError("Unexpected end of serialized data");
+            }
+        }
+
+        std::string_view data_;
+        size_t pos_ = 0;
+    };
+
+} // namespace serialization
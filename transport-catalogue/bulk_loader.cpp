@@ -0,0 +1,200 @@
+#include "bulk_loader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <utility>
+
+namespace transport_catalogue {
+
+    namespace {
+        // Меньшие куски не окупают передачу в пул
+        constexpr size_t MIN_CHUNK = 1024;
+    }
+
+    BulkLoader::BulkLoader(TransportCatalogue& db, size_t stop_count, size_t bus_count, size_t distance_count)
+        : db_(db)
+        , first_stop_(db.stops_.size())
+        , first_bus_(db.buses_.size()) {
+        db_.stop_name_to_stop_.reserve(first_stop_ + stop_count);
+        db_.stop_to_buses_.reserve(first_stop_ + stop_count);
+        db_.bus_name_to_bus_.reserve(first_bus_ + bus_count);
+        db_.distances_.reserve(db_.distances_.size() + distance_count);
+        bus_stop_names_.reserve(bus_count);
+        distances_.reserve(distance_count);
+    }
+
+    const domain::Stop& BulkLoader::AddStop(domain::Stop stop) {
+        stop.name = db_.names_->Intern(stop.name);
+        return db_.stops_.emplace_back(stop);
+    }
+
+    std::string_view BulkLoader::KeepName(std::string_view name) {
+        return db_.names_->Intern(name);
+    }
+
+    void BulkLoader::AddDistance(std::string_view from, std::string_view to, int distance) {
+        distances_.push_back({ from, to, distance });
+    }
+
+    void BulkLoader::AddBus(std::string_view name, std::vector<std::string_view> stop_names, bool is_roundtrip) {
+        db_.buses_.push_back({ db_.names_->Intern(name), {}, is_roundtrip });
+        bus_stop_names_.push_back(std::move(stop_names));
+    }
+
+    void BulkLoader::AddDistance(const domain::Stop* from, const domain::Stop* to, int distance) {
+        db_.distances_[{ from, to }] = distance;
+    }
+
+    void BulkLoader::AddBus(std::string_view name, std::vector<const domain::Stop*> stops, bool is_roundtrip) {
+        db_.buses_.push_back({ db_.names_->Intern(name), std::move(stops), is_roundtrip });
+        bus_stop_names_.emplace_back();
+    }
+
+    void BulkLoader::Finish(ThreadPool* pool) {
+        IndexNames(pool);
+        ResolveBusStops(pool);
+        const auto distance_stops = ResolveDistances(pool);
+
+        // Таблица расстояний заполняется одним потоком пула, пока остальные строят списки автобусов
+        std::future<void> distances_indexed;
+        if (pool) {
+            distances_indexed = pool->Submit([this, &distance_stops] { IndexDistances(distance_stops); });
+        }
+        else {
+            IndexDistances(distance_stops);
+        }
+        try {
+            IndexStopBuses(pool);
+        } catch (...) {
+            // Задача ссылается на distance_stops
+            if (distances_indexed.valid()) {
+                distances_indexed.wait();
+            }
+            throw;
+        }
+        if (distances_indexed.valid()) {
+            distances_indexed.get();
+        }
+
+        SortStopBuses(pool);
+        bus_stop_names_.clear();
+        distances_.clear();
+        db_.version_.Touch();
+    }
+
+    void BulkLoader::IndexNames(ThreadPool* pool) {
+        // В одну хеш-таблицу нельзя вставлять из нескольких потоков, поэтому параллельно
+        // заполняются три разные таблицы, каждая своим потоком
+        ParallelFor(pool, 3, 1, [this](size_t begin, size_t end) {
+            for (size_t part = begin; part < end; ++part) {
+                if (part == 0) {
+                    for (size_t i = first_stop_; i < db_.stops_.size(); ++i) {
+                        domain::Stop& stop = db_.stops_[i];
+                        db_.stop_name_to_stop_[stop.name] = &stop;
+                    }
+                }
+                else if (part == 1) {
+                    for (size_t i = first_stop_; i < db_.stops_.size(); ++i) {
+                        db_.stop_to_buses_[db_.stops_[i].name];
+                    }
+                }
+                else {
+                    for (size_t i = first_bus_; i < db_.buses_.size(); ++i) {
+                        domain::Bus& bus = db_.buses_[i];
+                        db_.bus_name_to_bus_[bus.name] = &bus;
+                    }
+                }
+            }
+        });
+    }
+
+    void BulkLoader::ResolveBusStops(ThreadPool* pool) {
+        // Индекс остановок только читается, поэтому маршруты разрешаются параллельно
+        ParallelFor(pool, bus_stop_names_.size(), MIN_CHUNK / 16, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                domain::Bus& bus = db_.buses_[first_bus_ + i];
+                bus.stops.reserve(bus_stop_names_[i].size());
+                for (const std::string_view stop_name : bus_stop_names_[i]) {
+                    if (const domain::Stop* stop = db_.FindStop(stop_name)) {
+                        bus.stops.push_back(stop);
+                    }
+                }
+            }
+        });
+    }
+
+    std::vector<BulkLoader::StopPair> BulkLoader::ResolveDistances(ThreadPool* pool) const {
+        std::vector<StopPair> stops(distances_.size());
+        ParallelFor(pool, distances_.size(), MIN_CHUNK, [this, &stops](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                stops[i] = { db_.FindStop(distances_[i].from), db_.FindStop(distances_[i].to) };
+            }
+        });
+        return stops;
+    }
+
+    void BulkLoader::IndexDistances(const std::vector<StopPair>& stops) {
+        // Порядок сохраняется: из повторов одной пары действует последнее расстояние
+        for (size_t i = 0; i < distances_.size(); ++i) {
+            if (stops[i].first && stops[i].second) {
+                db_.distances_[stops[i]] = distances_[i].distance;
+            }
+        }
+    }
+
+    void BulkLoader::IndexStopBuses(ThreadPool* pool) {
+        // Списки разных остановок независимы. Каждый кусок автобусов раскладывает пары
+        // (список остановки, автобус) по частям, а затем каждая часть дописывает только
+        // свои списки. Ключи таблицы созданы в IndexNames(), и здесь она только читается.
+        // Порядок автобусов в списке восстанавливает SortStopBuses()
+        using Entry = std::pair<std::vector<std::string_view>*, const domain::Bus*>;
+        const size_t part_count = pool ? pool->GetThreadCount() + 1 : 1;
+
+        std::mutex mutex;
+        std::vector<std::vector<std::vector<Entry>>> chunks;
+        ParallelFor(pool, db_.buses_.size() - first_bus_, MIN_CHUNK / 16, [&](size_t begin, size_t end) {
+            std::vector<std::vector<Entry>> parts(part_count);
+            for (size_t i = first_bus_ + begin; i < first_bus_ + end; ++i) {
+                const domain::Bus& bus = db_.buses_[i];
+                for (const domain::Stop* stop : bus.stops) {
+                    auto& buses = db_.stop_to_buses_.at(stop->name);
+                    const auto address = reinterpret_cast<std::uintptr_t>(&buses);
+                    parts[address / sizeof(buses) % part_count].emplace_back(&buses, &bus);
+                }
+            }
+            std::lock_guard lock(mutex);
+            chunks.push_back(std::move(parts));
+        });
+
+        ParallelFor(pool, part_count, 1, [&chunks](size_t begin, size_t end) {
+            for (size_t part = begin; part < end; ++part) {
+                for (const auto& parts : chunks) {
+                    for (const auto& [buses, bus] : parts[part]) {
+                        buses->push_back(bus->name);
+                    }
+                }
+            }
+        });
+    }
+
+    void BulkLoader::SortStopBuses(ThreadPool* pool) {
+        std::vector<std::vector<std::string_view>*> lists;
+        lists.reserve(db_.stop_to_buses_.size());
+        for (auto& [stop_name, buses] : db_.stop_to_buses_) {
+            if (buses.size() > 1) {
+                lists.push_back(&buses);
+            }
+        }
+
+        ParallelFor(pool, lists.size(), MIN_CHUNK, [&lists](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                auto& buses = *lists[i];
+                std::sort(buses.begin(), buses.end());
+                buses.erase(std::unique(buses.begin(), buses.end()), buses.end());
+            }
+        });
+    }
+
+} // namespace transport_catalogue
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "domain.h"
+#include "thread_pool.h"
+#include "transport_catalogue.h"
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace transport_catalogue {
+
+    // Пакетная загрузка каталога. Если количество объектов известно заранее,
+    // контейнеры резервируются один раз, а индексы имён, ссылки маршрутов и расстояний
+    // на остановки и списки автобусов по остановкам строятся одним проходом в Finish().
+    // Имена остановок и автобусов сразу копируются в пул имён каталога, а остальные
+    // строки, переданные как string_view, должны жить до вызова Finish()
+    class BulkLoader {
+    public:
+        BulkLoader(TransportCatalogue& db, size_t stop_count, size_t bus_count, size_t distance_count);
+
+        // Возвращает ссылку на остановку в каталоге; она не меняется до конца жизни каталога
+        const domain::Stop& AddStop(domain::Stop stop);
+
+        // Копирует имя в пул имён каталога, чтобы его можно было передать как string_view
+        // даже если исходная строка будет удалена. Одинаковые имена хранятся один раз
+        std::string_view KeepName(std::string_view name);
+
+        // Ссылки по именам разрешаются в Finish(). Неизвестные остановки пропускаются
+        void AddDistance(std::string_view from, std::string_view to, int distance);
+        void AddBus(std::string_view name, std::vector<std::string_view> stop_names, bool is_roundtrip);
+
+        // Ссылки на уже добавленные остановки, когда имена разрешать не нужно
+        void AddDistance(const domain::Stop* from, const domain::Stop* to, int distance);
+        void AddBus(std::string_view name, std::vector<const domain::Stop*> stops, bool is_roundtrip);
+
+        // Строит индексы каталога. Если передан пул, маршруты, расстояния и списки автобусов
+        // по остановкам обрабатываются по частям на всех его потоках
+        void Finish(ThreadPool* pool = nullptr);
+
+    private:
+        struct PendingDistance {
+            std::string_view from;
+            std::string_view to;
+            int distance;
+        };
+
+        using StopPair = std::pair<const domain::Stop*, const domain::Stop*>;
+
+        void IndexNames(ThreadPool* pool);
+        void ResolveBusStops(ThreadPool* pool);
+        std::vector<StopPair> ResolveDistances(ThreadPool* pool) const;
+        void IndexDistances(const std::vector<StopPair>& stops);
+        void IndexStopBuses(ThreadPool* pool);
+        void SortStopBuses(ThreadPool* pool);
+
+        TransportCatalogue& db_;
+        const size_t first_stop_;
+        const size_t first_bus_;
+        std::vector<std::vector<std::string_view>> bus_stop_names_;
+        std::vector<PendingDistance> distances_;
+    };
+
+} // namespace transport_catalogue
@@ -0,0 +1,462 @@
+#include "catalogue_image.h"
+
+#include "bulk_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace catalogue_image {
+
+    using namespace std::literals;
+
+    namespace {
+
+        constexpr char MAGIC[8] = { 'T', 'C', 'I', 'M', 'A', 'G', 'E', '\0' };
+        constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+        constexpr uint32_t FORMAT_VERSION = 1;
+        constexpr uint64_t ALIGNMENT = 8;
+
+        uint64_t AlignUp(uint64_t offset) {
+            return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        uint32_t CheckedU32(size_t value) {
+            if (value > std::numeric_limits<uint32_t>::max()) {
+                throw ImageError("Catalogue is too large for the image format"s);
+            }
+            return static_cast<uint32_t>(value);
+        }
+
+        // Раскладывает секции по файлу одну за другой
+        class Layout {
+        public:
+            template <typename T>
+            Section Place(const std::vector<T>& table) {
+                offset_ = AlignUp(offset_);
+                Section section{ offset_, table.size() };
+                offset_ += table.size() * sizeof(T);
+                return section;
+            }
+
+            uint64_t GetSize() const {
+                return offset_;
+            }
+
+        private:
+            uint64_t offset_ = sizeof(Header);
+        };
+
+        class SectionWriter {
+        public:
+            explicit SectionWriter(std::ostream& output) : output_(output) {}
+
+            void WriteHeader(const Header& header) {
+                Write(&header, sizeof(header));
+            }
+
+            template <typename T>
+            void WriteTable(const Section& section, const std::vector<T>& table) {
+                static const char padding[ALIGNMENT] = {};
+                Write(padding, section.offset - written_);
+                Write(table.data(), table.size() * sizeof(T));
+            }
+
+        private:
+            void Write(const void* data, uint64_t size) {
+                output_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                written_ += size;
+            }
+
+            std::ostream& output_;
+            uint64_t written_ = 0;
+        };
+
+    } // namespace
+
+    void WriteImage(const transport_catalogue::TransportCatalogue& db,
+                    const map_renderer::RenderSettings& render_settings,
+                    const TransportRouter::RoutingSettings& routing_settings,
+                    std::ostream& output) {
+        const auto& stops = db.GetAllStops();
+        const auto& buses = db.GetAllBuses();
+
+        std::vector<char> strings;
+        auto add_string = [&strings](std::string_view str) {
+            StringRef ref{ CheckedU32(strings.size()), CheckedU32(str.size()) };
+            strings.insert(strings.end(), str.begin(), str.end());
+            return ref;
+        };
+
+        std::unordered_map<const domain::Stop*, StopId> stop_index;
+        stop_index.reserve(stops.size());
+        std::vector<StopRecord> stop_records;
+        stop_records.reserve(stops.size());
+        for (const auto& stop : stops) {
+            stop_index.emplace(&stop, CheckedU32(stop_records.size()));
+            stop_records.push_back({ add_string(stop.name), stop.coordinates.lat, stop.coordinates.lng, 0, 0, 0, 0 });
+        }
+
+        std::unordered_map<const domain::Bus*, BusId> bus_index;
+        bus_index.reserve(buses.size());
+        std::vector<BusRecord> bus_records;
+        bus_records.reserve(buses.size());
+        std::vector<uint32_t> bus_stops;
+        for (const auto& bus : buses) {
+            bus_index.emplace(&bus, CheckedU32(bus_records.size()));
+            BusRecord record{ add_string(bus.name), CheckedU32(bus_stops.size()),
+                              CheckedU32(bus.stops.size()), bus.is_roundtrip, 0 };
+            for (const domain::Stop* stop : bus.stops) {
+                bus_stops.push_back(stop_index.at(stop));
+            }
+            bus_records.push_back(record);
+        }
+
+        // Расстояния группируются по исходной остановке и сортируются для двоичного поиска
+        std::vector<std::vector<DistanceRecord>> adjacency(stops.size());
+        for (const auto& [stops_pair, distance] : db.GetAllDistances()) {
+            adjacency[stop_index.at(stops_pair.first)].push_back({ stop_index.at(stops_pair.second), distance });
+        }
+        std::vector<DistanceRecord> distances;
+        distances.reserve(db.GetAllDistances().size());
+        for (size_t i = 0; i < adjacency.size(); ++i) {
+            auto& list = adjacency[i];
+            std::sort(list.begin(), list.end(), [](const DistanceRecord& lhs, const DistanceRecord& rhs) {
+                return lhs.to < rhs.to;
+            });
+            stop_records[i].distances_begin = CheckedU32(distances.size());
+            stop_records[i].distances_count = CheckedU32(list.size());
+            distances.insert(distances.end(), list.begin(), list.end());
+        }
+
+        // Списки автобусов по остановкам уже отсортированы каталогом
+        std::vector<uint32_t> stop_buses;
+        for (size_t i = 0; i < stops.size(); ++i) {
+            const auto& names = db.GetBusesForStop(stops[i].name);
+            stop_records[i].buses_begin = CheckedU32(stop_buses.size());
+            stop_records[i].buses_count = CheckedU32(names.size());
+            for (const std::string_view bus_name : names) {
+                stop_buses.push_back(bus_index.at(db.FindBus(bus_name)));
+            }
+        }
+
+        // Устойчивая сортировка: среди одноимённых объектов последний добавленный
+        // остаётся последним, как и в индексах TransportCatalogue
+        auto sorted_by_name = [&strings](const auto& records) {
+            std::vector<uint32_t> order(records.size());
+            std::iota(order.begin(), order.end(), 0u);
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+                const StringRef& l = records[lhs].name;
+                const StringRef& r = records[rhs].name;
+                return std::string_view(strings.data() + l.offset, l.size)
+                    < std::string_view(strings.data() + r.offset, r.size);
+            });
+            return order;
+        };
+        const std::vector<uint32_t> stop_names = sorted_by_name(stop_records);
+        const std::vector<uint32_t> bus_names = sorted_by_name(bus_records);
+
+        const std::string settings_data = serialization::SerializeSettings(render_settings, routing_settings);
+        const std::vector<char> settings(settings_data.begin(), settings_data.end());
+
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.byte_order = BYTE_ORDER_MARK;
+        header.version = FORMAT_VERSION;
+
+        Layout layout;
+        header.stops = layout.Place(stop_records);
+        header.buses = layout.Place(bus_records);
+        header.stop_names = layout.Place(stop_names);
+        header.bus_names = layout.Place(bus_names);
+        header.distances = layout.Place(distances);
+        header.stop_buses = layout.Place(stop_buses);
+        header.bus_stops = layout.Place(bus_stops);
+        header.strings = layout.Place(strings);
+        header.settings = layout.Place(settings);
+        header.file_size = layout.GetSize();
+
+        SectionWriter writer(output);
+        writer.WriteHeader(header);
+        writer.WriteTable(header.stops, stop_records);
+        writer.WriteTable(header.buses, bus_records);
+        writer.WriteTable(header.stop_names, stop_names);
+        writer.WriteTable(header.bus_names, bus_names);
+        writer.WriteTable(header.distances, distances);
+        writer.WriteTable(header.stop_buses, stop_buses);
+        writer.WriteTable(header.bus_stops, bus_stops);
+        writer.WriteTable(header.strings, strings);
+        writer.WriteTable(header.settings, settings);
+    }
+
+    void SaveImage(const transport_catalogue::TransportCatalogue& db,
+                   const map_renderer::RenderSettings& render_settings,
+                   const TransportRouter::RoutingSettings& routing_settings,
+                   const std::string& file) {
+        // Образ могут держать отображённым работающие процессы (MAP_SHARED), поэтому
+        // он не перезаписывается на месте: новый файл пишется рядом и подменяет старый
+        const std::string temp_file = file + ".tmp"s;
+        {
+            std::ofstream output(temp_file, std::ios::binary);
+            if (!output) {
+                throw ImageError("Failed to open "s + temp_file + " for writing"s);
+            }
+            WriteImage(db, render_settings, routing_settings, output);
+            output.close();
+            if (!output) {
+                std::remove(temp_file.c_str());
+                throw ImageError("Failed to write "s + temp_file);
+            }
+        }
+        if (std::rename(temp_file.c_str(), file.c_str()) != 0) {
+            std::remove(temp_file.c_str());
+            throw ImageError("Failed to replace "s + file);
+        }
+    }
+
+    std::string_view BusNameIterator::operator*() const {
+        return view_->GetBusName(*position_);
+    }
+
+    CatalogueView::CatalogueView(std::string_view data)
+        : data_(data) {
+        if (data_.size() < sizeof(Header)) {
+            throw ImageError("Catalogue image is too small"s);
+        }
+        header_ = reinterpret_cast<const Header*>(data_.data());
+        if (std::memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw ImageError("Not a catalogue image"s);
+        }
+        if (header_->byte_order != BYTE_ORDER_MARK) {
+            throw ImageError("Catalogue image has foreign byte order"s);
+        }
+        if (header_->version != FORMAT_VERSION) {
+            throw ImageError("Unsupported catalogue image version"s);
+        }
+        if (header_->file_size != data_.size()) {
+            throw ImageError("Catalogue image is truncated"s);
+        }
+
+        // Проверяем только границы секций: это O(1) и не затрагивает таблицы
+        GetTable<StopRecord>(header_->stops);
+        GetTable<BusRecord>(header_->buses);
+        GetTable<uint32_t>(header_->stop_names);
+        GetTable<uint32_t>(header_->bus_names);
+        GetTable<DistanceRecord>(header_->distances);
+        GetTable<uint32_t>(header_->stop_buses);
+        GetTable<uint32_t>(header_->bus_stops);
+        GetTable<char>(header_->strings);
+        GetTable<char>(header_->settings);
+        if (header_->stop_names.count != header_->stops.count || header_->bus_names.count != header_->buses.count) {
+            throw ImageError("Catalogue image name index is damaged"s);
+        }
+    }
+
+    template <typename T>
+    const T* CatalogueView::GetTable(const Section& section) const {
+        if (section.offset % alignof(T) != 0
+            || section.offset > data_.size()
+            || section.count > (data_.size() - section.offset) / sizeof(T)) {
+            throw ImageError("Catalogue image section is out of bounds"s);
+        }
+        return reinterpret_cast<const T*>(data_.data() + section.offset);
+    }
+
+    size_t CatalogueView::GetStopCount() const {
+        return header_->stops.count;
+    }
+
+    size_t CatalogueView::GetBusCount() const {
+        return header_->buses.count;
+    }
+
+    const StopRecord& CatalogueView::GetStopRecord(StopId stop) const {
+        if (stop >= header_->stops.count) {
+            throw ImageError("Stop index is out of range"s);
+        }
+        return GetTable<StopRecord>(header_->stops)[stop];
+    }
+
+    const BusRecord& CatalogueView::GetBusRecord(BusId bus) const {
+        if (bus >= header_->buses.count) {
+            throw ImageError("Bus index is out of range"s);
+        }
+        return GetTable<BusRecord>(header_->buses)[bus];
+    }
+
+    const uint32_t* CatalogueView::GetIndices(const Section& section, uint32_t begin, uint32_t count) const {
+        if (begin > section.count || count > section.count - begin) {
+            throw ImageError("Catalogue image index range is out of bounds"s);
+        }
+        return GetTable<uint32_t>(section) + begin;
+    }
+
+    std::string_view CatalogueView::GetString(StringRef ref) const {
+        if (ref.offset > header_->strings.count || ref.size > header_->strings.count - ref.offset) {
+            throw ImageError("Catalogue image string is out of bounds"s);
+        }
+        return { GetTable<char>(header_->strings) + ref.offset, ref.size };
+    }
+
+    std::string_view CatalogueView::GetStopName(StopId stop) const {
+        return GetString(GetStopRecord(stop).name);
+    }
+
+    geo::Coordinates CatalogueView::GetStopCoordinates(StopId stop) const {
+        const StopRecord& record = GetStopRecord(stop);
+        return { record.lat, record.lng };
+    }
+
+    std::string_view CatalogueView::GetBusName(BusId bus) const {
+        return GetString(GetBusRecord(bus).name);
+    }
+
+    std::optional<StopId> CatalogueView::FindStop(std::string_view name) const {
+        const uint32_t* begin = GetTable<uint32_t>(header_->stop_names);
+        const uint32_t* end = begin + header_->stop_names.count;
+        // Последний из одноимённых, как в TransportCatalogue
+        auto it = std::upper_bound(begin, end, name, [this](std::string_view value, uint32_t stop) {
+            return value < GetStopName(stop);
+        });
+        if (it == begin || GetStopName(*(it - 1)) != name) {
+            return std::nullopt;
+        }
+        return *(it - 1);
+    }
+
+    std::optional<BusId> CatalogueView::FindBus(std::string_view name) const {
+        const uint32_t* begin = GetTable<uint32_t>(header_->bus_names);
+        const uint32_t* end = begin + header_->bus_names.count;
+        auto it = std::upper_bound(begin, end, name, [this](std::string_view value, uint32_t bus) {
+            return value < GetBusName(bus);
+        });
+        if (it == begin || GetBusName(*(it - 1)) != name) {
+            return std::nullopt;
+        }
+        return *(it - 1);
+    }
+
+    const DistanceRecord* CatalogueView::GetDistanceRecords(const StopRecord& record) const {
+        if (record.distances_begin > header_->distances.count
+            || record.distances_count > header_->distances.count - record.distances_begin) {
+            throw ImageError("Catalogue image distance range is out of bounds"s);
+        }
+        return GetTable<DistanceRecord>(header_->distances) + record.distances_begin;
+    }
+
+    std::optional<int> CatalogueView::FindDistance(StopId from, StopId to) const {
+        const StopRecord& record = GetStopRecord(from);
+        const DistanceRecord* begin = GetDistanceRecords(record);
+        const DistanceRecord* end = begin + record.distances_count;
+        auto it = std::lower_bound(begin, end, to, [](const DistanceRecord& distance, StopId stop) {
+            return distance.to < stop;
+        });
+        if (it == end || it->to != to) {
+            return std::nullopt;
+        }
+        return it->distance;
+    }
+
+    int CatalogueView::GetDistance(StopId from, StopId to) const {
+        if (auto distance = FindDistance(from, to)) {
+            return *distance;
+        }
+        if (auto distance = FindDistance(to, from)) {
+            return *distance;
+        }
+        return static_cast<int>(geo::ComputeDistance(GetStopCoordinates(from), GetStopCoordinates(to)));
+    }
+
+    std::optional<transport_catalogue::BusInfo> CatalogueView::GetBusInfo(std::string_view bus_name) const {
+        const auto bus = FindBus(bus_name);
+        if (!bus) {
+            return std::nullopt;
+        }
+        const BusRecord& record = GetBusRecord(*bus);
+        if (record.stops_count == 0) {
+            return std::nullopt;
+        }
+        const uint32_t* stops = GetIndices(header_->bus_stops, record.stops_begin, record.stops_count);
+        const size_t count = record.stops_count;
+
+        // Расчёт повторяет TransportCatalogue::GetBusInfo, чтобы ответы совпадали
+        transport_catalogue::BusInfo info;
+        info.stops_count = record.is_roundtrip ? count : count * 2 - 1;
+
+        std::unordered_set<std::string_view> unique_stops;
+        for (size_t i = 0; i < count; ++i) {
+            unique_stops.insert(GetStopName(stops[i]));
+        }
+        info.unique_stops_count = unique_stops.size();
+
+        double straight_distance = 0.0;
+        int road_distance = 0;
+        for (size_t i = 1; i < count; ++i) {
+            road_distance += GetDistance(stops[i - 1], stops[i]);
+            straight_distance += geo::ComputeDistance(GetStopCoordinates(stops[i - 1]),
+                                                      GetStopCoordinates(stops[i]));
+        }
+        if (!record.is_roundtrip) {
+            for (size_t i = count - 1; i > 0; --i) {
+                road_distance += GetDistance(stops[i], stops[i - 1]);
+            }
+            straight_distance *= 2.0;
+        }
+
+        info.route_length = road_distance;
+        info.curvature = straight_distance > 0 ? road_distance / straight_distance : 0.0;
+        return info;
+    }
+
+    BusNameRange CatalogueView::GetBusesForStop(StopId stop) const {
+        const StopRecord& record = GetStopRecord(stop);
+        const uint32_t* begin = GetIndices(header_->stop_buses, record.buses_begin, record.buses_count);
+        return { BusNameIterator(this, begin), BusNameIterator(this, begin + record.buses_count) };
+    }
+
+    serialization::BaseSettings CatalogueView::GetSettings() const {
+        return serialization::DeserializeSettings(
+            { GetTable<char>(header_->settings), static_cast<size_t>(header_->settings.count) });
+    }
+
+    transport_catalogue::TransportCatalogue CatalogueView::Materialize() const {
+        transport_catalogue::TransportCatalogue db;
+        transport_catalogue::BulkLoader loader(db, GetStopCount(), GetBusCount(), header_->distances.count);
+
+        std::vector<const domain::Stop*> stops;
+        stops.reserve(GetStopCount());
+        for (StopId stop = 0; stop < GetStopCount(); ++stop) {
+            stops.push_back(&loader.AddStop({ GetStopName(stop), GetStopCoordinates(stop) }));
+        }
+
+        for (StopId from = 0; from < GetStopCount(); ++from) {
+            const StopRecord& record = GetStopRecord(from);
+            const DistanceRecord* distances = GetDistanceRecords(record);
+            for (uint32_t i = 0; i < record.distances_count; ++i) {
+                const DistanceRecord& distance = distances[i];
+                loader.AddDistance(stops[from], stops.at(distance.to), distance.distance);
+            }
+        }
+
+        for (BusId bus = 0; bus < GetBusCount(); ++bus) {
+            const BusRecord& record = GetBusRecord(bus);
+            const uint32_t* indices = GetIndices(header_->bus_stops, record.stops_begin, record.stops_count);
+            std::vector<const domain::Stop*> bus_stops;
+            bus_stops.reserve(record.stops_count);
+            for (uint32_t i = 0; i < record.stops_count; ++i) {
+                bus_stops.push_back(stops.at(indices[i]));
+            }
+            loader.AddBus(GetString(record.name), std::move(bus_stops), record.is_roundtrip != 0);
+        }
+
+        loader.Finish();
+        return db;
+    }
+
+} // namespace catalogue_image
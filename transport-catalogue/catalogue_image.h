@@ -0,0 +1,194 @@
+#pragma once
+
+#include "geo.h"
+#include "ranges.h"
+#include "serialization.h"
+#include "transport_catalogue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace catalogue_image {
+
+    // Образ каталога, который читается прямо из отображённого в память файла.
+    // Все таблицы лежат в файле по смещениям от его начала и выровнены по 8 байтам,
+    // ссылки между объектами — индексы, имена — ссылки в общий блок строк.
+    // Числа хранятся в порядке байт платформы, записавшей образ
+    //
+    // Header
+    // stops       StopRecord[]      в порядке добавления в каталог
+    // buses       BusRecord[]       в порядке добавления в каталог
+    // stop_names  u32[]             индексы остановок, отсортированные по имени
+    // bus_names   u32[]             индексы автобусов, отсортированные по имени
+    // distances   DistanceRecord[]  сгруппированы по исходной остановке, внутри по to
+    // stop_buses  u32[]             автобусы каждой остановки в порядке имён
+    // bus_stops   u32[]             остановки маршрутов
+    // strings     char[]            имена остановок и автобусов
+    // settings    char[]            настройки в формате serialization::SerializeSettings
+
+    class ImageError : public std::runtime_error {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    using StopId = uint32_t;
+    using BusId = uint32_t;
+
+    struct Section {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct StringRef {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t byte_order;
+        uint32_t version;
+        uint64_t file_size;
+        Section stops;
+        Section buses;
+        Section stop_names;
+        Section bus_names;
+        Section distances;
+        Section stop_buses;
+        Section bus_stops;
+        Section strings;
+        Section settings;
+    };
+
+    struct StopRecord {
+        StringRef name;
+        double lat;
+        double lng;
+        uint32_t distances_begin;
+        uint32_t distances_count;
+        uint32_t buses_begin;
+        uint32_t buses_count;
+    };
+
+    struct BusRecord {
+        StringRef name;
+        uint32_t stops_begin;
+        uint32_t stops_count;
+        uint32_t is_roundtrip;
+        uint32_t reserved;
+    };
+
+    struct DistanceRecord {
+        StopId to;
+        int32_t distance;
+    };
+
+    void WriteImage(const transport_catalogue::TransportCatalogue& db,
+                    const map_renderer::RenderSettings& render_settings,
+                    const TransportRouter::RoutingSettings& routing_settings,
+                    std::ostream& output);
+
+    void SaveImage(const transport_catalogue::TransportCatalogue& db,
+                   const map_renderer::RenderSettings& render_settings,
+                   const TransportRouter::RoutingSettings& routing_settings,
+                   const std::string& file);
+
+    class CatalogueView;
+
+    // Итератор по именам автобусов остановки; имена не копируются
+    class BusNameIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = std::string_view;
+
+        BusNameIterator(const CatalogueView* view, const uint32_t* position)
+            : view_(view)
+            , position_(position) {
+        }
+
+        std::string_view operator*() const;
+
+        BusNameIterator& operator++() {
+            ++position_;
+            return *this;
+        }
+
+        BusNameIterator operator++(int) {
+            BusNameIterator copy = *this;
+            ++position_;
+            return copy;
+        }
+
+        bool operator==(const BusNameIterator& other) const {
+            return position_ == other.position_;
+        }
+
+        bool operator!=(const BusNameIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const CatalogueView* view_;
+        const uint32_t* position_;
+    };
+
+    using BusNameRange = ranges::Range<BusNameIterator>;
+
+    // Каталог только для чтения поверх образа. При открытии проверяется лишь заголовок,
+    // ничего не копируется; ссылки внутри таблиц проверяются при обращении.
+    // Данные должны жить дольше представления
+    class CatalogueView {
+    public:
+        explicit CatalogueView(std::string_view data);
+
+        size_t GetStopCount() const;
+        size_t GetBusCount() const;
+        // Размер образа в байтах
+        size_t GetSize() const {
+            return data_.size();
+        }
+
+        std::optional<StopId> FindStop(std::string_view name) const;
+        std::optional<BusId> FindBus(std::string_view name) const;
+
+        std::string_view GetStopName(StopId stop) const;
+        geo::Coordinates GetStopCoordinates(StopId stop) const;
+        std::string_view GetBusName(BusId bus) const;
+
+        // Те же правила, что и в TransportCatalogue::GetDistance
+        int GetDistance(StopId from, StopId to) const;
+
+        std::optional<transport_catalogue::BusInfo> GetBusInfo(std::string_view bus_name) const;
+        // Имена автобусов в лексикографическом порядке
+        BusNameRange GetBusesForStop(StopId stop) const;
+
+        serialization::BaseSettings GetSettings() const;
+
+        // Строит полноценный каталог (для построения карты и маршрутов)
+        transport_catalogue::TransportCatalogue Materialize() const;
+
+    private:
+        template <typename T>
+        const T* GetTable(const Section& section) const;
+
+        const StopRecord& GetStopRecord(StopId stop) const;
+        const BusRecord& GetBusRecord(BusId bus) const;
+        const DistanceRecord* GetDistanceRecords(const StopRecord& record) const;
+        const uint32_t* GetIndices(const Section& section, uint32_t begin, uint32_t count) const;
+        std::string_view GetString(StringRef ref) const;
+        std::optional<int> FindDistance(StopId from, StopId to) const;
+
+        std::string_view data_;
+        const Header* header_ = nullptr;
+    };
+
+} // namespace catalogue_image
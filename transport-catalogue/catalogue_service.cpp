@@ -0,0 +1,170 @@
+#include "catalogue_service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <optional>
+
+namespace {
+
+    // Меньше мёртвых имён пул не пересобирается
+    constexpr size_t MIN_STALE_NAMES = 1024;
+
+    // Пул имён общий у всех версий каталога, и имена из него не удаляются: имена удалённых
+    // объектов и отброшенных пачек остаются в нём. Когда их становится больше, чем живых,
+    // следующая версия копируется в новый пул, а старый освобождается вместе с последней
+    // ссылающейся на него версией. Так память пула не растёт вместе с числом изменений
+    bool NeedsFreshNamePool(const transport_catalogue::TransportCatalogue& db) {
+        const size_t live_names = db.GetAllStops().size() + db.GetAllBuses().size();
+        return db.GetNamePool()->GetSize() > 2 * live_names + MIN_STALE_NAMES;
+    }
+
+} // namespace
+
+CatalogueSnapshot::CatalogueSnapshot(transport_catalogue::TransportCatalogue db,
+                                     const map_renderer::RenderSettings& render_settings,
+                                     const TransportRouter::RoutingSettings& routing_settings)
+    : db_(std::move(db))
+    , renderer_(render_settings)
+    , routing_settings_(routing_settings)
+    , router_(db_, routing_settings_)
+    , handler_(db_, renderer_, &router_) {
+}
+
+CatalogueService::CatalogueService(transport_catalogue::TransportCatalogue db,
+                                   map_renderer::RenderSettings render_settings,
+                                   TransportRouter::RoutingSettings routing_settings)
+    : current_(std::make_shared<const CatalogueSnapshot>(std::move(db), render_settings, routing_settings)) {
+}
+
+std::shared_ptr<const CatalogueSnapshot> CatalogueService::GetSnapshot() const {
+    return std::atomic_load(&current_);
+}
+
+void CatalogueService::ApplyUpdates(const std::vector<transport_catalogue::CatalogueUpdate>& updates) {
+    if (const auto error = ApplyBatches({ &updates }).front()) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<std::exception_ptr> CatalogueService::ApplyBatches(
+    const std::vector<const std::vector<transport_catalogue::CatalogueUpdate>*>& batches) {
+    const auto current = GetSnapshot();
+    std::vector<std::exception_ptr> errors(batches.size());
+
+    // Каталог копируется один раз на все пачки. Если пачка падает на середине, копия
+    // с её частью выбрасывается, и пачки применяются заново к новой копии без неё.
+    // Каждый перезапуск исключает ещё одну пачку, поэтому копий не больше, чем ошибок плюс одна
+    const auto& db = current->GetCatalogue();
+    const bool fresh_names = NeedsFreshNamePool(db);
+    std::optional<transport_catalogue::TransportCatalogue> next_db;
+    while (!next_db) {
+        if (std::all_of(errors.begin(), errors.end(), [](const auto& error) { return error != nullptr; })) {
+            return errors;
+        }
+        if (fresh_names) {
+            next_db.emplace(db, std::make_shared<transport_catalogue::NamePool>());
+        }
+        else {
+            next_db.emplace(db);
+        }
+        for (size_t i = 0; i < batches.size(); ++i) {
+            if (errors[i]) {
+                continue;
+            }
+            try {
+                transport_catalogue::ApplyUpdates(*next_db, *batches[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+                next_db.reset();
+                break;
+            }
+        }
+    }
+
+    try {
+        // Роутер строится в конструкторе снимка, до публикации
+        auto next = std::make_shared<const CatalogueSnapshot>(
+            std::move(*next_db), current->GetRenderSettings(), current->GetRoutingSettings());
+        std::atomic_store(&current_, std::shared_ptr<const CatalogueSnapshot>(std::move(next)));
+    } catch (...) {
+        // Опубликованной остаётся предыдущая версия, и не применилась ни одна пачка
+        for (auto& error : errors) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    return errors;
+}
+
+CatalogueUpdater::CatalogueUpdater(CatalogueService& service)
+    : service_(service)
+    , worker_([this] { Run(); }) {
+}
+
+CatalogueUpdater::~CatalogueUpdater() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    has_work_.notify_one();
+    worker_.join();
+}
+
+std::future<void> CatalogueUpdater::Submit(std::vector<transport_catalogue::CatalogueUpdate> updates) {
+    std::future<void> applied;
+    {
+        std::lock_guard lock(mutex_);
+        pending_.push_back({ std::move(updates), {} });
+        applied = pending_.back().applied.get_future();
+    }
+    has_work_.notify_one();
+    return applied;
+}
+
+void CatalogueUpdater::Wait() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] { return pending_.empty() && !busy_; });
+}
+
+void CatalogueUpdater::Run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        has_work_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            // Остановка запрошена и очередь пуста
+            break;
+        }
+
+        std::vector<Batch> batches;
+        batches.swap(pending_);
+        busy_ = true;
+        lock.unlock();
+
+        std::vector<const std::vector<transport_catalogue::CatalogueUpdate>*> updates;
+        updates.reserve(batches.size());
+        for (const auto& batch : batches) {
+            updates.push_back(&batch.updates);
+        }
+        std::vector<std::exception_ptr> errors;
+        try {
+            errors = service_.ApplyBatches(updates);
+        } catch (...) {
+            errors.assign(batches.size(), std::current_exception());
+        }
+        // Опубликованной для отвергнутых пачек остаётся предыдущая версия
+        for (size_t i = 0; i < batches.size(); ++i) {
+            if (errors[i]) {
+                batches[i].applied.set_exception(errors[i]);
+            }
+            else {
+                batches[i].applied.set_value();
+            }
+        }
+
+        lock.lock();
+        busy_ = false;
+        idle_.notify_all();
+    }
+}
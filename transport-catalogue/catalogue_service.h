@@ -0,0 +1,102 @@
+#pragma once
+
+#include "catalogue_update.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Неизменяемая версия каталога вместе с построенными по ней роутером и рендерером.
+// Объект не копируется и не перемещается: RequestHandler и TransportRouter
+// хранят ссылки на его поля
+class CatalogueSnapshot {
+public:
+    CatalogueSnapshot(transport_catalogue::TransportCatalogue db,
+                      const map_renderer::RenderSettings& render_settings,
+                      const TransportRouter::RoutingSettings& routing_settings);
+
+    CatalogueSnapshot(const CatalogueSnapshot&) = delete;
+    CatalogueSnapshot& operator=(const CatalogueSnapshot&) = delete;
+
+    const transport_catalogue::TransportCatalogue& GetCatalogue() const { return db_; }
+    const RequestHandler& GetHandler() const { return handler_; }
+    const map_renderer::RenderSettings& GetRenderSettings() const { return renderer_.GetSettings(); }
+    const TransportRouter::RoutingSettings& GetRoutingSettings() const { return routing_settings_; }
+
+private:
+    const transport_catalogue::TransportCatalogue db_;
+    const map_renderer::MapRenderer renderer_;
+    const TransportRouter::RoutingSettings routing_settings_;
+    const TransportRouter router_;
+    const RequestHandler handler_;
+};
+
+// Хранит текущую опубликованную версию каталога (схема RCU).
+// Читатели берут снимок через GetSnapshot() и работают с ним без блокировок
+// сколько угодно долго; писатель собирает новую версию целиком и атомарно
+// подменяет указатель. Старая версия освобождается, когда её отпустит последний читатель
+class CatalogueService {
+public:
+    CatalogueService(transport_catalogue::TransportCatalogue db,
+                     map_renderer::RenderSettings render_settings,
+                     TransportRouter::RoutingSettings routing_settings);
+
+    std::shared_ptr<const CatalogueSnapshot> GetSnapshot() const;
+
+    // Копирует текущий каталог, применяет изменения, строит роутер
+    // и только после этого публикует новую версию.
+    // Должен вызываться из одного потока-писателя
+    void ApplyUpdates(const std::vector<transport_catalogue::CatalogueUpdate>& updates);
+    // То же для нескольких пачек с одной копией каталога и одной пересборкой роутера.
+    // Пачки применяются по очереди, и пачка, на которой случилась ошибка, пропускается,
+    // не задевая остальных: они применяются заново к свежей копии.
+    // Возвращает ошибку каждой пачки (nullptr, если она опубликована)
+    std::vector<std::exception_ptr> ApplyBatches(
+        const std::vector<const std::vector<transport_catalogue::CatalogueUpdate>*>& batches);
+
+private:
+    std::shared_ptr<const CatalogueSnapshot> current_;
+};
+
+// Поток-писатель: принимает пачки изменений из любых потоков и применяет их
+// к CatalogueService в фоне. Накопившиеся пачки публикуются одной пересборкой,
+// но ошибка в одной из них достаётся только её отправителю
+class CatalogueUpdater {
+public:
+    explicit CatalogueUpdater(CatalogueService& service);
+    ~CatalogueUpdater();
+
+    CatalogueUpdater(const CatalogueUpdater&) = delete;
+    CatalogueUpdater& operator=(const CatalogueUpdater&) = delete;
+
+    // Возвращённый future готов, когда пачка опубликована, или хранит ошибку её применения
+    std::future<void> Submit(std::vector<transport_catalogue::CatalogueUpdate> updates);
+
+    // Блокируется, пока все отправленные изменения не будут опубликованы
+    void Wait();
+
+private:
+    struct Batch {
+        std::vector<transport_catalogue::CatalogueUpdate> updates;
+        std::promise<void> applied;
+    };
+
+    void Run();
+
+    CatalogueService& service_;
+    std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::condition_variable idle_;
+    std::vector<Batch> pending_;
+    bool busy_ = false;
+    bool stopping_ = false;
+    std::thread worker_;
+};
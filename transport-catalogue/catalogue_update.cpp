@@ -0,0 +1,72 @@
+#include "catalogue_update.h"
+
+namespace transport_catalogue {
+
+    namespace {
+
+        struct UpdateApplier {
+            TransportCatalogue& db;
+
+            void operator()(const StopUpdate& update) const {
+                if (!db.UpdateStop(update.name, update.coordinates)) {
+                    db.AddStop({ update.name, update.coordinates });
+                }
+            }
+
+            void operator()(const BusUpdate& update) const {
+                std::vector<const domain::Stop*> stops;
+                stops.reserve(update.stops.size());
+                for (const auto& stop_name : update.stops) {
+                    if (const domain::Stop* stop = db.FindStop(stop_name)) {
+                        stops.push_back(stop);
+                    }
+                }
+                if (!db.UpdateBus(update.name, stops, update.is_roundtrip)) {
+                    db.AddBus({ update.name, std::move(stops), update.is_roundtrip });
+                }
+            }
+
+            void operator()(const DistanceUpdate& update) const {
+                const domain::Stop* from = db.FindStop(update.from);
+                const domain::Stop* to = db.FindStop(update.to);
+                if (from && to) {
+                    db.SetDistance(from, to, update.distance);
+                }
+            }
+
+            // Место освобождает Compact() после применения всех изменений
+            void operator()(const StopRemoval& update) const {
+                db.MarkStopRemoved(update.name);
+            }
+
+            void operator()(const BusRemoval& update) const {
+                db.MarkBusRemoved(update.name);
+            }
+
+            void operator()(const DistanceRemoval& update) const {
+                const domain::Stop* from = db.FindStop(update.from);
+                const domain::Stop* to = db.FindStop(update.to);
+                if (from && to) {
+                    db.RemoveDistance(from, to);
+                }
+            }
+        };
+
+    } // namespace
+
+    void ApplyUpdate(TransportCatalogue& db, const CatalogueUpdate& update) {
+        std::visit(UpdateApplier{ db }, update);
+        db.Compact();
+    }
+
+    void ApplyUpdates(TransportCatalogue& db, const std::vector<CatalogueUpdate>& updates) {
+        // Удаления только помечают объекты, поэтому их стоимость зависит от числа
+        // связанных маршрутов, а каталог перестраивается не больше одного раза
+        const UpdateApplier applier{ db };
+        for (const auto& update : updates) {
+            std::visit(applier, update);
+        }
+        db.Compact();
+    }
+
+} // namespace transport_catalogue
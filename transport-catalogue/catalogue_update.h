@@ -0,0 +1,54 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "geo.h"
+
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace transport_catalogue {
+
+    // Изменения каталога описываются по именам, а не по указателям,
+    // поэтому их можно применять к любой копии каталога
+
+    // Добавляет остановку или меняет координаты существующей
+    struct StopUpdate {
+        std::string name;
+        geo::Coordinates coordinates;
+    };
+
+    // Добавляет автобус или заменяет маршрут существующего.
+    // Неизвестные остановки пропускаются, как и при загрузке из JSON
+    struct BusUpdate {
+        std::string name;
+        std::vector<std::string> stops;
+        bool is_roundtrip = false;
+    };
+
+    struct DistanceUpdate {
+        std::string from;
+        std::string to;
+        int distance = 0;
+    };
+
+    struct StopRemoval {
+        std::string name;
+    };
+
+    struct BusRemoval {
+        std::string name;
+    };
+
+    struct DistanceRemoval {
+        std::string from;
+        std::string to;
+    };
+
+    using CatalogueUpdate = std::variant<StopUpdate, BusUpdate, DistanceUpdate,
+                                         StopRemoval, BusRemoval, DistanceRemoval>;
+
+    void ApplyUpdate(TransportCatalogue& db, const CatalogueUpdate& update);
+    void ApplyUpdates(TransportCatalogue& db, const std::vector<CatalogueUpdate>& updates);
+
+} // namespace transport_catalogue
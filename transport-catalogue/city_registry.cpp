@@ -0,0 +1,46 @@
+#include "city_registry.h"
+
+#include <memory>
+#include <vector>
+
+CityRegistry::CityRegistry(const json::Dict& cities, ThreadPool& pool, const CityLoader& load)
+    : names_(std::make_shared<transport_catalogue::NamePool>()) {
+    std::vector<const json::Dict::value_type*> items;
+    items.reserve(cities.size());
+    for (const auto& item : cities) {
+        items.push_back(&item);
+    }
+
+    std::vector<std::unique_ptr<const CatalogueSnapshot>> snapshots(items.size());
+    ParallelFor(&pool, items.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            snapshots[i] = load(items[i]->second, names_);
+        }
+    });
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        cities_.emplace(items[i]->first, std::move(snapshots[i]));
+    }
+}
+
+const RequestHandler* CityRegistry::FindHandler(std::string_view city) const {
+    if (auto it = cities_.find(city); it != cities_.end()) {
+        return &it->second->GetHandler();
+    }
+    return nullptr;
+}
+
+memory_stats::Report CityRegistry::GetMemoryStats() const {
+    memory_stats::Report report{ { "names", names_->GetSize(), names_->GetMemoryUsage() } };
+    for (const auto& [name, snapshot] : cities_) {
+        for (auto& entry : snapshot->GetHandler().GetMemoryStats()) {
+            // Пул имён у всех городов общий и уже учтён
+            if (entry.name == "catalogue.names") {
+                continue;
+            }
+            entry.name = name + '.' + entry.name;
+            report.push_back(std::move(entry));
+        }
+    }
+    return report;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "catalogue_service.h"
+#include "json.h"
+#include "memory_stats.h"
+#include "name_pool.h"
+#include "request_handler.h"
+#include "thread_pool.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Несколько независимых городов в одном процессе: у каждого свой каталог,
+// роутер и рендерер, а пул потоков и пул имён общие: одинаковые имена остановок
+// и автобусов разных городов хранятся один раз. Запросы направляются по полю city
+class CityRegistry {
+public:
+    // Строит город по его части входного документа; имена каталога города хранятся в names
+    using CityLoader = std::function<std::unique_ptr<const CatalogueSnapshot>(
+        const json::Node& city, const std::shared_ptr<transport_catalogue::NamePool>& names)>;
+
+    // Города загружаются параллельно, по одной задаче пула на город.
+    // Внутри задачи загрузка идёт без пула: задачи пула не должны ждать друг друга
+    CityRegistry(const json::Dict& cities, ThreadPool& pool, const CityLoader& load);
+
+    const RequestHandler* FindHandler(std::string_view city) const;
+
+    // Отчёты всех городов; имена контейнеров предваряются именем города.
+    // Общий пул имён учитывается один раз, как names
+    memory_stats::Report GetMemoryStats() const;
+
+private:
+    std::shared_ptr<transport_catalogue::NamePool> names_;
+    std::map<std::string, std::unique_ptr<const CatalogueSnapshot>, std::less<>> cities_;
+};
@@ -0,0 +1,261 @@
+#include "delta_log.h"
+
+#include "binary_io.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <variant>
+
+namespace serialization {
+
+    using namespace std::literals;
+
+    namespace {
+
+        constexpr std::string_view MAGIC = "TCD"sv;
+        constexpr uint8_t FORMAT_VERSION = 1;
+        constexpr size_t HEADER_SIZE = MAGIC.size() + sizeof(FORMAT_VERSION);
+        constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+        enum class UpdateTag : uint8_t {
+            STOP_UPDATE,
+            BUS_UPDATE,
+            DISTANCE_UPDATE,
+            STOP_REMOVAL,
+            BUS_REMOVAL,
+            DISTANCE_REMOVAL,
+        };
+
+        // FNV-1a: отличает повреждённую запись от целой
+        uint32_t Checksum(std::string_view data) {
+            uint32_t hash = 2166136261u;
+            for (const char c : data) {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        struct UpdateWriter {
+            BinaryWriter& writer;
+
+            void operator()(const transport_catalogue::StopUpdate& update) const {
+                writer.Write(UpdateTag::STOP_UPDATE);
+                writer.WriteString(update.name);
+                writer.Write(update.coordinates.lat);
+                writer.Write(update.coordinates.lng);
+            }
+
+            void operator()(const transport_catalogue::BusUpdate& update) const {
+                writer.Write(UpdateTag::BUS_UPDATE);
+                writer.WriteString(update.name);
+                writer.Write(static_cast<uint8_t>(update.is_roundtrip));
+                writer.WriteSize(update.stops.size());
+                for (const auto& stop : update.stops) {
+                    writer.WriteString(stop);
+                }
+            }
+
+            void operator()(const transport_catalogue::DistanceUpdate& update) const {
+                writer.Write(UpdateTag::DISTANCE_UPDATE);
+                writer.WriteString(update.from);
+                writer.WriteString(update.to);
+                writer.Write(static_cast<int32_t>(update.distance));
+            }
+
+            void operator()(const transport_catalogue::StopRemoval& update) const {
+                writer.Write(UpdateTag::STOP_REMOVAL);
+                writer.WriteString(update.name);
+            }
+
+            void operator()(const transport_catalogue::BusRemoval& update) const {
+                writer.Write(UpdateTag::BUS_REMOVAL);
+                writer.WriteString(update.name);
+            }
+
+            void operator()(const transport_catalogue::DistanceRemoval& update) const {
+                writer.Write(UpdateTag::DISTANCE_REMOVAL);
+                writer.WriteString(update.from);
+                writer.WriteString(update.to);
+            }
+        };
+
+        transport_catalogue::CatalogueUpdate ReadUpdate(BinaryReader& reader) {
+            switch (reader.Read<UpdateTag>()) {
+                case UpdateTag::STOP_UPDATE: {
+                    transport_catalogue::StopUpdate update;
+                    update.name = reader.ReadString();
+                    update.coordinates.lat = reader.Read<double>();
+                    update.coordinates.lng = reader.Read<double>();
+                    return update;
+                }
+                case UpdateTag::BUS_UPDATE: {
+                    transport_catalogue::BusUpdate update;
+                    update.name = reader.ReadString();
+                    update.is_roundtrip = reader.Read<uint8_t>() != 0;
+                    update.stops.resize(reader.ReadCount(sizeof(uint32_t)));
+                    for (auto& stop : update.stops) {
+                        stop = reader.ReadString();
+                    }
+                    return update;
+                }
+                case UpdateTag::DISTANCE_UPDATE: {
+                    transport_catalogue::DistanceUpdate update;
+                    update.from = reader.ReadString();
+                    update.to = reader.ReadString();
+                    update.distance = reader.Read<int32_t>();
+                    return update;
+                }
+                case UpdateTag::STOP_REMOVAL:
+                    return transport_catalogue::StopRemoval{ std::string(reader.ReadString()) };
+                case UpdateTag::BUS_REMOVAL:
+                    return transport_catalogue::BusRemoval{ std::string(reader.ReadString()) };
+                case UpdateTag::DISTANCE_REMOVAL: {
+                    transport_catalogue::DistanceRemoval update;
+                    update.from = reader.ReadString();
+                    update.to = reader.ReadString();
+                    return update;
+                }
+            }
+            throw SerializationError("Unknown update tag in delta log"s);
+        }
+
+        std::string ReadFile(const std::string& file) {
+            std::ifstream input(file, std::ios::binary | std::ios::ate);
+            if (!input) {
+                return {};
+            }
+            std::string data(static_cast<size_t>(input.tellg()), '\0');
+            input.seekg(0);
+            if (!input.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+                throw SerializationError("Failed to read "s + file);
+            }
+            return data;
+        }
+
+        void CheckHeader(std::string_view data) {
+            if (data.size() < HEADER_SIZE || data.substr(0, MAGIC.size()) != MAGIC) {
+                throw SerializationError("Not a catalogue delta log"s);
+            }
+            if (static_cast<uint8_t>(data[MAGIC.size()]) != FORMAT_VERSION) {
+                throw SerializationError("Unsupported delta log version"s);
+            }
+        }
+
+        // Разбирает записи журнала и вызывает on_batch для каждой целой записи.
+        // Возвращает длину целой части журнала
+        template <typename OnBatch>
+        size_t ParseRecords(std::string_view data, OnBatch on_batch) {
+            CheckHeader(data);
+            size_t pos = HEADER_SIZE;
+            while (data.size() - pos >= RECORD_HEADER_SIZE) {
+                BinaryReader header(data.substr(pos, RECORD_HEADER_SIZE));
+                const size_t size = header.ReadSize();
+                const uint32_t checksum = header.Read<uint32_t>();
+                if (data.size() - pos - RECORD_HEADER_SIZE < size) {
+                    break;
+                }
+                const std::string_view body = data.substr(pos + RECORD_HEADER_SIZE, size);
+                if (Checksum(body) != checksum) {
+                    // Запись повреждена: если за ней ничего нет, это недописанный хвост
+                    if (pos + RECORD_HEADER_SIZE + size == data.size()) {
+                        break;
+                    }
+                    throw SerializationError("Corrupted record in delta log"s);
+                }
+                on_batch(body);
+                pos += RECORD_HEADER_SIZE + size;
+            }
+            return pos;
+        }
+
+    } // namespace
+
+    DeltaLog::DeltaLog(const std::string& file)
+        : file_(file) {
+        const std::string data = ReadFile(file_);
+        if (data.empty()) {
+            output_.open(file_, std::ios::binary | std::ios::trunc);
+            output_.write(MAGIC.data(), MAGIC.size());
+            output_.put(static_cast<char>(FORMAT_VERSION));
+        }
+        else {
+            const size_t valid_size = ParseRecords(data, [](std::string_view) {});
+            if (valid_size < data.size()) {
+                std::filesystem::resize_file(file_, valid_size);
+            }
+            output_.open(file_, std::ios::binary | std::ios::app);
+        }
+        if (!output_.flush()) {
+            throw SerializationError("Failed to open "s + file_ + " for writing"s);
+        }
+    }
+
+    void DeltaLog::Append(const std::vector<transport_catalogue::CatalogueUpdate>& updates) {
+        std::ostringstream body_stream;
+        {
+            BinaryWriter writer(body_stream);
+            writer.WriteSize(updates.size());
+            for (const auto& update : updates) {
+                std::visit(UpdateWriter{ writer }, update);
+            }
+        }
+        const std::string body = body_stream.str();
+
+        std::ostringstream record;
+        {
+            BinaryWriter writer(record);
+            writer.WriteSize(body.size());
+            writer.Write(Checksum(body));
+        }
+        record << body;
+
+        const std::string data = record.str();
+        output_.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!output_.flush()) {
+            throw SerializationError("Failed to write "s + file_);
+        }
+    }
+
+    std::vector<transport_catalogue::CatalogueUpdate> ReadDeltaLog(const std::string& file) {
+        std::vector<transport_catalogue::CatalogueUpdate> updates;
+        const std::string data = ReadFile(file);
+        if (data.empty()) {
+            return updates;
+        }
+        ParseRecords(data, [&updates](std::string_view body) {
+            BinaryReader reader(body);
+            const size_t count = reader.ReadSize();
+            for (size_t i = 0; i < count; ++i) {
+                updates.push_back(ReadUpdate(reader));
+            }
+            if (!reader.AtEnd()) {
+                throw SerializationError("Trailing data in delta log record"s);
+            }
+        });
+        return updates;
+    }
+
+    size_t ReplayDeltaLog(transport_catalogue::TransportCatalogue& db, const std::string& file) {
+        const auto updates = ReadDeltaLog(file);
+        transport_catalogue::ApplyUpdates(db, updates);
+        return updates.size();
+    }
+
+    TransportBase CompactBase(const std::string& base_file, const std::string& log_file, ThreadPool* pool) {
+        TransportBase base = LoadBase(base_file, pool);
+        ReplayDeltaLog(base.db, log_file);
+
+        // Новая база сначала пишется рядом и только потом подменяет старую
+        const std::string temp_file = base_file + ".tmp"s;
+        SaveBase(base.db, base.render_settings, base.routing_settings, temp_file);
+        if (std::rename(temp_file.c_str(), base_file.c_str()) != 0) {
+            throw SerializationError("Failed to replace "s + base_file);
+        }
+        std::remove(log_file.c_str());
+        return base;
+    }
+
+} // namespace serialization
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "catalogue_update.h"
+#include "serialization.h"
+#include "thread_pool.h"
+#include "transport_catalogue.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace serialization {
+
+    // Журнал изменений каталога, который только дописывается в конец.
+    // Запуск с журналом стоит загрузки базы плюс применения изменений,
+    // а не разбора base_requests всего города.
+    //
+    // Заголовок: "TCD" + версия формата (1 байт)
+    // Далее записи: { u32 размер тела, u32 контрольная сумма тела, тело }
+    // Тело — пакет изменений: u32 k, k × { u8 тег, поля изменения }
+    //
+    // Пакет пишется одной записью и применяется либо целиком, либо никак:
+    // недописанная последняя запись (сбой во время записи) при чтении отбрасывается
+    class DeltaLog {
+    public:
+        // Открывает журнал для дописывания, при необходимости создаёт его
+        // и обрезает недописанную последнюю запись
+        explicit DeltaLog(const std::string& file);
+
+        void Append(const std::vector<transport_catalogue::CatalogueUpdate>& updates);
+
+    private:
+        std::string file_;
+        std::ofstream output_;
+    };
+
+    // Все изменения из журнала по порядку. Отсутствующий файл — пустой журнал
+    std::vector<transport_catalogue::CatalogueUpdate> ReadDeltaLog(const std::string& file);
+
+    // Применяет журнал к каталогу, возвращает число изменений
+    size_t ReplayDeltaLog(transport_catalogue::TransportCatalogue& db, const std::string& file);
+
+    // Сворачивает журнал в новую базу: загружает базу, применяет журнал,
+    // атомарно заменяет файл базы и удаляет журнал. Возвращает новую базу.
+    // Если сбой случится между заменой базы и удалением журнала, журнал будет
+    // применён повторно; изменения описываются состоянием, а не приращением,
+    // поэтому результат от этого не меняется
+    TransportBase CompactBase(const std::string& base_file, const std::string& log_file, ThreadPool* pool = nullptr);
+
+} // namespace serialization
@@ -1,18 +1,19 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 #include <vector>
 #include "geo.h"
 
 namespace domain {
 
+    // Имена хранятся в пуле имён каталога (transport_catalogue::NamePool)
     struct Stop {
-        std::string name;
+        std::string_view name;
         geo::Coordinates coordinates;
     };
 
     struct Bus {
-        std::string name;
+        std::string_view name;
         std::vector<const Stop*> stops;
         bool is_roundtrip;
     };
@@ -32,6 +32,8 @@ public:
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // Память рёбер и списков смежности в байтах
+    size_t GetMemoryUsage() const;
 
 private:
     std::vector<Edge<Weight>> edges_;
@@ -66,6 +68,16 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
     return edges_.at(edge_id);
 }
 
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+    size_t bytes = edges_.capacity() * sizeof(Edge<Weight>)
+        + incidence_lists_.capacity() * sizeof(IncidenceList);
+    for (const auto& list : incidence_lists_) {
+        bytes += list.capacity() * sizeof(EdgeId);
+    }
+    return bytes;
+}
+
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
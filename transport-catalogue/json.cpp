@@ -1,336 +1,655 @@
 #include "json.h"
-
+#include "msgpack.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
 #include <iterator>
+#include <string_view>
 
 namespace json {
 
-namespace {
 using namespace std::literals;
 
-Node LoadNode(std::istream& input);
-Node LoadString(std::istream& input);
+// Разбирает документ из буфера в памяти или из потока, который читается
+// блоками по мере разбора. Грамматика и сообщения об ошибках те же, что были
+// у посимвольного разбора из std::istream: пробельные символы — как у operator>>,
+// лишние данные после корневого значения игнорируются.
+// Объявлен в json.h, чтобы ValueReader мог читать прямо из него
+class Parser {
+public:
+    explicit Parser(std::string_view input)
+        : pos_(input.data())
+        , end_(input.data() + input.size()) {
+    }
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
+    explicit Parser(std::istream& input)
+        : input_(&input)
+        , buffer_(BUFFER_SIZE) {
     }
-    return s;
-}
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
+    Node LoadNode() {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        return LoadNodeStartingWith(c);
+    }
 
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
+    // Корневое значение документа. Массивы и словари размещаются в аренах memory,
+    // значение каждого ключа корневого словаря — в своей. Массивы под ключами
+    // из handlers не сохраняются: каждый элемент передаётся обработчику сразу после разбора
+    Node LoadRoot(DocumentMemory& memory, const StreamingHandlers& handlers) {
+        resource_ = &memory.root;
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        if (c != '{') {
+            return LoadNodeStartingWith(c);
         }
-        result.push_back(LoadNode(input));
+        return LoadDict([this, &memory, &handlers](const std::string& key) -> Node {
+            resource_ = &memory.members[key];
+            Node value = LoadMember(key, handlers);
+            resource_ = &memory.root;
+            return value;
+        });
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+
+private:
+    friend class ValueReader;
+
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    Node LoadMember(std::string_view key, const StreamingHandlers& handlers) {
+        const auto handler = handlers.find(key);
+        if (handler == handlers.end()) {
+            return LoadNode();
+        }
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        if (c != '[') {
+            return LoadNodeStartingWith(c);
+        }
+        // Прочитанное обработчиком размещается в арене элемента, которая сбрасывается после него
+        std::pmr::memory_resource* const member_resource = resource_;
+        resource_ = &element_memory_;
+        LoadElements([this, &handler] {
+            ValueReader reader(*this);
+            handler->second(reader);
+            element_memory_.release();
+        });
+        resource_ = member_resource;
+        return Array{};
     }
-    return Node(std::move(result));
-}
 
-Node LoadDict(std::istream& input) {
-    Dict dict;
+    char ReadValueStart() {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        return c;
+    }
+
+    // Следующий элемент массива после '[': false, если массив закончился.
+    // Запятые между элементами, как и раньше, необязательны
+    bool NextElement() {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Array parsing error"s);
+        }
+        if (c == ']') {
+            return false;
+        }
+        if (c != ',') {
+            --pos_;
+        }
+        return true;
+    }
 
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
+    // Следующий ключ словаря после '{' вместе с двоеточием: false, если словарь закончился
+    bool NextKey(std::string& key) {
+        char c;
+        while (ReadChar(c)) {
+            if (c == '}') {
+                return false;
+            }
+            if (c == '"') {
+                key.clear();
+                LoadString(key);
+                // Как и при чтении из потока, при конце ввода в c остаётся прочитанная ранее кавычка
+                if (ReadChar(c) && c == ':') {
+                    return true;
                 }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
                 throw ParsingError(": is expected but '"s + c + "' has been found"s);
             }
-        } else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
         }
-    }
-    if (!input) {
         throw ParsingError("Dictionary parsing error"s);
     }
-    return Node(std::move(dict));
-}
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
+
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    static bool IsDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool IsAlpha(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    static bool IsSpecialStringChar(char c) {
+        return c == '"' || c == '\\' || c == '\n' || c == '\r';
+    }
+
+    // Есть ли ещё символы; при чтении из потока подгружает следующий блок.
+    // Последний прочитанный символ остаётся в буфере, пока не вызван Available()
+    bool Available() {
+        return pos_ != end_ || Refill();
+    }
+
+    bool Refill() {
+        if (!input_) {
+            return false;
         }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-            ++it;
-            if (it == end) {
-                throw ParsingError("String parsing error");
-            }
-            const char escaped_char = *(it);
-            switch (escaped_char) {
-                case 'n':
-                    s.push_back('\n');
-                    break;
-                case 't':
-                    s.push_back('\t');
-                    break;
-                case 'r':
-                    s.push_back('\r');
-                    break;
-                case '"':
-                    s.push_back('"');
-                    break;
-                case '\\':
-                    s.push_back('\\');
-                    break;
-                default:
-                    throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+        input_->read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        if (input_->gcount() == 0) {
+            return false;
+        }
+        pos_ = buffer_.data();
+        end_ = pos_ + input_->gcount();
+        return true;
+    }
+
+    // Аналог input >> c: пропускает пробелы и читает символ
+    bool ReadChar(char& c) {
+        do {
+            while (pos_ != end_ && IsSpace(*pos_)) {
+                ++pos_;
             }
-        } else if (ch == '\n' || ch == '\r') {
-            throw ParsingError("Unexpected end of line"s);
-        } else {
-            s.push_back(ch);
+        } while (pos_ == end_ && Refill());
+        if (pos_ == end_) {
+            return false;
         }
-        ++it;
+        c = *pos_++;
+        return true;
     }
 
-    return Node(std::move(s));
-}
+    bool PeekIs(char c) {
+        return Available() && *pos_ == c;
+    }
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv) {
-        return Node{true};
-    } else if (s == "false"sv) {
-        return Node{false};
-    } else {
-        throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+    bool PeekDigit() {
+        return Available() && IsDigit(*pos_);
     }
-}
 
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
-        return Node{nullptr};
-    } else {
-        throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+    Node LoadNodeStartingWith(char c) {
+        switch (c) {
+            case '[':
+                return LoadArray();
+            case '{':
+                return LoadDict();
+            case '"':
+                return LoadString();
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                --pos_;
+                return LoadBool();
+            case 'n':
+                --pos_;
+                return LoadNull();
+            default:
+                --pos_;
+                return LoadNumber();
+        }
     }
-}
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
+    Node LoadArray() {
+        const size_t first = array_stack_.size();
+        LoadElements([this] {
+            array_stack_.push_back(LoadNode());
+        });
+        Array result(std::make_move_iterator(array_stack_.begin() + first),
+                     std::make_move_iterator(array_stack_.end()), resource_);
+        array_stack_.resize(first);
+        return Node(std::move(result));
+    }
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
+    // read_element() читает очередной элемент из входа
+    template <typename ReadElement>
+    void LoadElements(ReadElement read_element) {
+        while (NextElement()) {
+            read_element();
         }
-    };
+    }
+
+    Node LoadDict() {
+        return LoadDict([this](const std::string&) {
+            return LoadNode();
+        });
+    }
+
+    template <typename LoadValue>
+    Node LoadDict(LoadValue load_value) {
+        // Пары собираются в порядке ввода и сортируются один раз в конце
+        const size_t first = dict_stack_.size();
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
+        std::string key;
+        while (NextKey(key)) {
+            Node value = load_value(key);
+            dict_stack_.emplace_back(std::move(key), std::move(value));
         }
-        while (std::isdigit(input.peek())) {
-            read_char();
+        const auto items = dict_stack_.begin() + first;
+        std::sort(items, dict_stack_.end(), [](const Dict::value_type& lhs, const Dict::value_type& rhs) {
+            return lhs.first < rhs.first;
+        });
+        auto equal = [](const Dict::value_type& lhs, const Dict::value_type& rhs) {
+            return lhs.first == rhs.first;
+        };
+        if (auto it = std::adjacent_find(items, dict_stack_.end(), equal); it != dict_stack_.end()) {
+            throw ParsingError("Duplicate key '"s + it->first + "' have been found");
         }
-    };
+        Dict dict(Dict::Items(std::make_move_iterator(items),
+                              std::make_move_iterator(dict_stack_.end()), resource_));
+        dict_stack_.erase(items, dict_stack_.end());
+        return Node(std::move(dict));
+    }
 
-    if (input.peek() == '-') {
-        read_char();
+    Node LoadString() {
+        std::string s;
+        LoadString(s);
+        return Node(std::move(s));
     }
-    // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
-        // После 0 в JSON не могут идти другие цифры
-    } else {
-        read_digits();
+
+    // Дописывает к s строку после открывающей кавычки
+    void LoadString(std::string& s) {
+        while (true) {
+            if (!Available()) {
+                throw ParsingError("String parsing error");
+            }
+            // Обычные символы копируются сразу отрезками до ближайшего особого символа
+            const char* run_end = pos_;
+            while (run_end != end_ && !IsSpecialStringChar(*run_end)) {
+                ++run_end;
+            }
+            s.append(pos_, run_end);
+            pos_ = run_end;
+            if (pos_ == end_) {
+                continue;
+            }
+
+            const char ch = *pos_++;
+            if (ch == '"') {
+                break;
+            } else if (ch == '\\') {
+                if (!Available()) {
+                    throw ParsingError("String parsing error");
+                }
+                const char escaped_char = *pos_++;
+                switch (escaped_char) {
+                    case 'n':
+                        s.push_back('\n');
+                        break;
+                    case 't':
+                        s.push_back('\t');
+                        break;
+                    case 'r':
+                        s.push_back('\r');
+                        break;
+                    case '"':
+                        s.push_back('"');
+                        break;
+                    case '\\':
+                        s.push_back('\\');
+                        break;
+                    default:
+                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                }
+            } else {
+                throw ParsingError("Unexpected end of line"s);
+            }
+        }
     }
 
-    bool is_int = true;
-    // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
-        is_int = false;
+    std::string LoadLiteral() {
+        std::string s;
+        while (Available() && IsAlpha(*pos_)) {
+            s.push_back(*pos_++);
+        }
+        return s;
     }
 
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
+    Node LoadBool() {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            return Node{true};
+        } else if (s == "false"sv) {
+            return Node{false};
+        } else {
+            throw ParsingError("Failed to parse '"s + s + "' as bool"s);
         }
-        read_digits();
-        is_int = false;
     }
 
-    try {
+    Node LoadNull() {
+        if (auto literal = LoadLiteral(); literal == "null"sv) {
+            return Node{nullptr};
+        } else {
+            throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+        }
+    }
+
+    Node LoadNumber() {
+        // Число может попасть на границу блоков, поэтому собирается в отдельный буфер
+        std::string& number = number_;
+        number.clear();
+
+        auto read_char = [this, &number] {
+            number.push_back(*pos_++);
+        };
+
+        // Считывает одну или более цифр
+        auto read_digits = [this, read_char] {
+            if (!PeekDigit()) {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (PeekDigit()) {
+                read_char();
+            }
+        };
+
+        if (PeekIs('-')) {
+            read_char();
+        }
+        // Парсим целую часть числа
+        if (PeekIs('0')) {
+            read_char();
+            // После 0 в JSON не могут идти другие цифры
+        } else {
+            read_digits();
+        }
+
+        bool is_int = true;
+        // Парсим дробную часть числа
+        if (PeekIs('.')) {
+            read_char();
+            read_digits();
+            is_int = false;
+        }
+
+        // Парсим экспоненциальную часть числа
+        if (PeekIs('e') || PeekIs('E')) {
+            read_char();
+            if (PeekIs('+') || PeekIs('-')) {
+                read_char();
+            }
+            read_digits();
+            is_int = false;
+        }
+
+        const char* begin = number.data();
+        const char* end = begin + number.size();
         if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
+            // Сначала пробуем преобразовать строку в int;
+            // при переполнении код ниже попробует преобразовать её в double
+            int value;
+            if (auto [ptr, ec] = std::from_chars(begin, end, value); ec == std::errc{}) {
+                return value;
+            }
+        }
+        double value;
+        auto [ptr, ec] = std::from_chars(begin, end, value);
+        if (ec == std::errc{} && std::fabs(value) < 2 * DBL_MIN) {
+            // У границы нормализованных чисел решение о потере точности
+            // принимает strtod, как раньше внутри std::stod
+            errno = 0;
+            value = std::strtod(number.c_str(), nullptr);
+            if (errno == ERANGE) {
+                ec = std::errc::result_out_of_range;
             }
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
-    }
-}
-
-Node LoadNode(std::istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
-    }
-    switch (c) {
-        case '[':
-            return LoadArray(input);
-        case '{':
-            return LoadDict(input);
-        case '"':
-            return LoadString(input);
-        case 't':
-            // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-            // подсказкой компилятору и человеку, что здесь программист явно задумывал
-            // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-            // написать break, return или throw.
-            // В данном случае, встретив t или f, переходим к попытке парсинга
-            // литералов true либо false
-            [[fallthrough]];
-        case 'f':
-            input.putback(c);
-            return LoadBool(input);
-        case 'n':
-            input.putback(c);
-            return LoadNull(input);
-        default:
-            input.putback(c);
-            return LoadNumber(input);
+        if (ec != std::errc{}) {
+            throw ParsingError("Failed to convert "s + number + " to number"s);
+        }
+        return value;
+    }
+
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+    std::istream* input_ = nullptr;
+    std::vector<char> buffer_;
+    std::string number_;
+    // Элементы незакрытых массивов и словарей копятся в общих стеках,
+    // а готовый массив или словарь получает вектор ровно нужного размера
+    // Объявлена раньше стеков: при ошибке разбора в них могут остаться узлы из неё
+    std::pmr::monotonic_buffer_resource element_memory_;
+    std::vector<Node> array_stack_;
+    std::vector<Dict::value_type> dict_stack_;
+    // Откуда выделяется память готовых массивов и словарей
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+    // Последние ключ и строка, прочитанные через ValueReader
+    std::string reader_key_;
+    std::string reader_string_;
+};
+
+void ValueReader::StartDict() {
+    if (parser_.ReadValueStart() != '{') {
+        throw std::logic_error("Not a dict"s);
     }
 }
 
+bool ValueReader::NextKey(std::string_view& key) {
+    if (!parser_.NextKey(parser_.reader_key_)) {
+        return false;
+    }
+    key = parser_.reader_key_;
+    return true;
+}
+
+void ValueReader::StartArray() {
+    if (parser_.ReadValueStart() != '[') {
+        throw std::logic_error("Not an array"s);
+    }
+}
+
+bool ValueReader::NextElement() {
+    return parser_.NextElement();
+}
+
+std::string_view ValueReader::ReadString() {
+    if (parser_.ReadValueStart() != '"') {
+        throw std::logic_error("Not a string"s);
+    }
+    parser_.reader_string_.clear();
+    parser_.LoadString(parser_.reader_string_);
+    return parser_.reader_string_;
+}
+
+// Числа и литералы не выделяют памяти, поэтому читаются через Node
+int ValueReader::ReadInt() {
+    return parser_.LoadNode().AsInt();
+}
+
+double ValueReader::ReadDouble() {
+    return parser_.LoadNode().AsDouble();
+}
+
+bool ValueReader::ReadBool() {
+    return parser_.LoadNode().AsBool();
+}
+
+Node ValueReader::ReadNode() {
+    return parser_.LoadNode();
+}
+
+void ValueReader::Skip() {
+    parser_.LoadNode();
+}
+
+OutputBuffer::OutputBuffer()
+    : buffer_(INITIAL_SIZE, '\0') {
+}
+
+OutputBuffer::OutputBuffer(std::ostream& out)
+    : out_(&out)
+    , buffer_(INITIAL_SIZE, '\0') {
+}
+
+void OutputBuffer::Write(std::string_view text) {
+    if (text.size() > buffer_.size() - size_) {
+        MakeRoom(text.size());
+        // Длинные строки не дробятся по размеру буфера
+        if (text.size() > buffer_.size() - size_) {
+            out_->write(text.data(), static_cast<std::streamsize>(text.size()));
+            return;
+        }
+    }
+    text.copy(buffer_.data() + size_, text.size());
+    size_ += text.size();
+}
+
+void OutputBuffer::Flush() {
+    if (out_) {
+        out_->write(buffer_.data(), static_cast<std::streamsize>(size_));
+        size_ = 0;
+    }
+}
+
+void OutputBuffer::Replace(size_t pos, size_t count, std::string_view bytes) {
+    if (pos + count > size_ || bytes.size() > count) {
+        throw std::out_of_range("OutputBuffer::Replace() out of range");
+    }
+    bytes.copy(buffer_.data() + pos, bytes.size());
+    if (bytes.size() < count) {
+        char* const tail = buffer_.data() + pos + count;
+        std::copy(tail, buffer_.data() + size_, tail - (count - bytes.size()));
+        size_ -= count - bytes.size();
+    }
+}
+
+void OutputBuffer::MakeRoom(size_t count) {
+    if (out_) {
+        Flush();
+    } else {
+        buffer_.resize(std::max(buffer_.size() * 2, size_ + count));
+    }
+}
+
+namespace {
+
+// Для каждого байта — символ после '\', если байт экранируется, иначе 0
+constexpr std::array<char, 256> MakeEscapes() {
+    std::array<char, 256> escapes{};
+    escapes['\r'] = 'r';
+    escapes['\n'] = 'n';
+    escapes['\t'] = 't';
+    escapes['"'] = '"';
+    escapes['\\'] = '\\';
+    return escapes;
+}
+
+constexpr std::array<char, 256> ESCAPES = MakeEscapes();
+
 struct PrintContext {
-    std::ostream& out;
-    int indent_step = 4;
+    OutputBuffer& out;
+    const PrintSettings& settings;
     int indent = 0;
 
+    // В компактном режиме пробелы и переводы строк не выводятся
     void PrintIndent() const {
-        for (int i = 0; i < indent; ++i) {
-            out.put(' ');
+        if (!settings.compact) {
+            for (int i = 0; i < indent; ++i) {
+                out.Put(' ');
+            }
+        }
+    }
+
+    void PrintLineBreak() const {
+        if (!settings.compact) {
+            out.Put('\n');
         }
     }
 
     PrintContext Indented() const {
-        return {out, indent_step, indent_step + indent};
+        return {out, settings, settings.indent_step + indent};
     }
 };
 
 void PrintNode(const Node& value, const PrintContext& ctx);
 
-template <typename Value>
-void PrintValue(const Value& value, const PrintContext& ctx) {
-    ctx.out << value;
+void PrintValue(const std::string& value, const PrintContext& ctx) {
+    PrintString(value, ctx.out);
 }
 
-void PrintString(const std::string& value, std::ostream& out) {
-    out.put('"');
-    for (const char c : value) {
-        switch (c) {
-            case '\r':
-                out << "\\r"sv;
-                break;
-            case '\n':
-                out << "\\n"sv;
-                break;
-            case '\t':
-                out << "\\t"sv;
-                break;
-            case '"':
-                // Символы " и \ выводятся как \" или \\, соответственно
-                [[fallthrough]];
-            case '\\':
-                out.put('\\');
-                [[fallthrough]];
-            default:
-                out.put(c);
-                break;
-        }
-    }
-    out.put('"');
+void PrintValue(std::nullptr_t, const PrintContext& ctx) {
+    ctx.out.Write("null"sv);
 }
 
-template <>
-void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
-    PrintString(value, ctx.out);
+void PrintValue(bool value, const PrintContext& ctx) {
+    ctx.out.Write(value ? "true"sv : "false"sv);
 }
 
-template <>
-void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
-    ctx.out << "null"sv;
+void PrintValue(int value, const PrintContext& ctx) {
+    PrintNumber(value, ctx.out);
 }
 
-// В специализации шаблона PrintValue для типа bool параметр value передаётся
-// по константной ссылке, как и в основном шаблоне.
-// В качестве альтернативы можно использовать перегрузку:
-// void PrintValue(bool value, const PrintContext& ctx);
-template <>
-void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
-    ctx.out << (value ? "true"sv : "false"sv);
+void PrintValue(double value, const PrintContext& ctx) {
+    PrintNumber(value, ctx.settings.precision, ctx.out);
 }
 
-template <>
-void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "[\n"sv;
+void PrintValue(const Array& nodes, const PrintContext& ctx) {
+    OutputBuffer& out = ctx.out;
+    out.Put('[');
+    ctx.PrintLineBreak();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const Node& node : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.Put(',');
+            ctx.PrintLineBreak();
         }
         inner_ctx.PrintIndent();
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintLineBreak();
     ctx.PrintIndent();
-    out.put(']');
+    out.Put(']');
 }
 
-template <>
-void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "{\n"sv;
+void PrintValue(const Dict& nodes, const PrintContext& ctx) {
+    OutputBuffer& out = ctx.out;
+    out.Put('{');
+    ctx.PrintLineBreak();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const auto& [key, node] : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.Put(',');
+            ctx.PrintLineBreak();
         }
         inner_ctx.PrintIndent();
-        PrintString(key, ctx.out);
-        out << ": "sv;
+        PrintString(key, out);
+        out.Write(ctx.settings.compact ? ":"sv : ": "sv);
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintLineBreak();
     ctx.PrintIndent();
-    out.put('}');
+    out.Put('}');
 }
 
 void PrintNode(const Node& node, const PrintContext& ctx) {
@@ -341,14 +660,183 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
         node.GetValue());
 }
 
+template <typename Input>
+Document LoadDocument(Input& input, const StreamingHandlers& handlers) {
+    // Арена создаётся раньше разборщика: при ошибке в его стеках могут остаться узлы из неё
+    auto memory = std::make_unique<DocumentMemory>();
+    Parser parser(input);
+    Node root = parser.LoadRoot(*memory, handlers);
+    return Document(std::move(root), std::move(memory));
+}
+
 }  // namespace
 
+Document Load(std::string_view input) {
+    return LoadDocument(input, {});
+}
+
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    return LoadDocument(input, {});
+}
+
+Document LoadStreaming(std::istream& input, const StreamingHandlers& handlers) {
+    return LoadDocument(input, handlers);
+}
+
+void Document::Release(std::string_view key) {
+    if (!root_.IsDict()) {
+        return;
+    }
+    auto& root = std::get<Dict>(root_.GetValue());
+    auto it = root.find(key);
+    if (it == root.end()) {
+        return;
+    }
+    it->second = it->second.IsArray() ? Node(Array{})
+               : it->second.IsDict() ? Node(Dict{})
+               : Node{};
+    if (memory_) {
+        if (auto member = memory_->members.find(key); member != memory_->members.end()) {
+            memory_->members.erase(member);
+        }
+    }
+}
+
+void PrintString(std::string_view value, OutputBuffer& out) {
+    out.Put('"');
+    // Участки без экранируемых символов копируются целиком
+    size_t run_begin = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        const char escape = ESCAPES[static_cast<unsigned char>(value[i])];
+        if (escape != 0) {
+            out.Write(value.substr(run_begin, i - run_begin));
+            out.Put('\\');
+            out.Put(escape);
+            run_begin = i + 1;
+        }
+    }
+    out.Write(value.substr(run_begin));
+    out.Put('"');
+}
+
+void PrintNumber(int value, OutputBuffer& out) {
+    out.WriteNumber([value](char* first, char* last) {
+        return std::to_chars(first, last, value).ptr;
+    });
+}
+
+void PrintNumber(double value, int precision, OutputBuffer& out) {
+    out.WriteNumber([value, precision](char* first, char* last) {
+        if (precision == SHORTEST_PRECISION) {
+            return std::to_chars(first, last, value).ptr;
+        }
+        // Совпадает с выводом operator<< для потока с такой точностью
+        return std::to_chars(first, last, value, std::chars_format::general, precision).ptr;
+    });
+}
+
+void PrintNode(const Node& node, OutputBuffer& out, const PrintSettings& settings, int indent) {
+    if (settings.encoding == Encoding::MESSAGE_PACK) {
+        msgpack::WriteNode(node, out);
+        return;
+    }
+    PrintNode(node, PrintContext{out, settings, indent});
+}
+
+std::string EncodeString(std::string_view value, Encoding encoding) {
+    OutputBuffer buffer;
+    if (encoding == Encoding::MESSAGE_PACK) {
+        msgpack::WriteString(value, buffer);
+    } else {
+        PrintString(value, buffer);
+    }
+    return std::string(buffer.GetData());
 }
 
 void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+    // Как у operator<<: точность потока, при нулевой — одна значащая цифра
+    PrintSettings settings;
+    settings.precision = std::max(1, static_cast<int>(output.precision()));
+    Print(doc, output, settings);
+}
+
+void Print(const Document& doc, std::ostream& output, const PrintSettings& settings) {
+    OutputBuffer buffer(output);
+    PrintNode(doc.GetRoot(), buffer, settings, 0);
+    buffer.Flush();
+}
+
+ArrayWriter::ArrayWriter(std::ostream& output, const PrintSettings& settings)
+    : settings_(settings)
+    , buffer_(output) {
+    if (!IsMessagePack()) {
+        buffer_.Put('[');
+        PrintContext{buffer_, settings_}.PrintLineBreak();
+    }
+}
+
+void ArrayWriter::SetSize(size_t size) {
+    if (size_ || !empty_) {
+        throw std::logic_error("ArrayWriter::SetSize() must be called once before the first element");
+    }
+    size_ = size;
+    if (IsMessagePack()) {
+        buffer_.Write(msgpack::MakeArrayHeader(size).Get());
+    }
+}
+
+void ArrayWriter::Write(const Node& element) {
+    PrintNode(element, StartElement(), settings_, GetElementIndent());
+    EndElement();
+}
+
+void ArrayWriter::WriteSerialized(std::string_view element) {
+    StartElement().Write(element);
+    EndElement();
+}
+
+OutputBuffer& ArrayWriter::StartElement() {
+    if (IsMessagePack()) {
+        if (!size_) {
+            throw std::logic_error("ArrayWriter::SetSize() is required for MessagePack");
+        }
+        empty_ = false;
+        element_buffer_.Clear();
+        return element_buffer_;
+    }
+    const PrintContext ctx{buffer_, settings_};
+    if (empty_) {
+        empty_ = false;
+    } else {
+        buffer_.Put(',');
+        ctx.PrintLineBreak();
+    }
+    ctx.Indented().PrintIndent();
+    return buffer_;
+}
+
+void ArrayWriter::EndElement() {
+    ++count_;
+    if (IsMessagePack()) {
+        buffer_.Write(element_buffer_.GetData());
+    }
+    buffer_.Flush();
+}
+
+void ArrayWriter::Finish() {
+    if (size_ && count_ != *size_) {
+        throw std::logic_error("ArrayWriter::Finish(): element count differs from SetSize()");
+    }
+    if (IsMessagePack()) {
+        if (!size_) {
+            buffer_.Write(msgpack::MakeArrayHeader(0).Get());
+        }
+        buffer_.Flush();
+        return;
+    }
+    PrintContext{buffer_, settings_}.PrintLineBreak();
+    buffer_.Put(']');
+    buffer_.Flush();
 }
 
 }  // namespace json
@@ -1,16 +1,80 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 namespace json {
 
     class Node;
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+    // Массивы и словари разобранного документа лежат в его арене (см. Document);
+    // созданные в программе используют обычную кучу
+    using Array = std::pmr::vector<Node>;
+
+    // Словарь JSON: пары лежат в одном векторе, отсортированном по ключу.
+    // Поиск — двоичный, вставка сдвигает хвост, поэтому словарь рассчитан на небольшое
+    // число ключей, как у объектов во входных запросах. Короткие ключи и строковые значения
+    // хранятся внутри std::string без отдельного выделения памяти.
+    // Ключи через итераторы менять нельзя: порядок нарушится
+    class Dict {
+    public:
+        using key_type = std::string;
+        using mapped_type = Node;
+        using value_type = std::pair<std::string, Node>;
+        using Items = std::pmr::vector<value_type>;
+        using iterator = Items::iterator;
+        using const_iterator = Items::const_iterator;
+
+        Dict() = default;
+        Dict(std::initializer_list<value_type> items);
+        // Сортирует пары по ключу; при повторяющихся ключах выбрасывает std::logic_error
+        explicit Dict(Items items);
+
+        iterator begin() { return items_.begin(); }
+        iterator end() { return items_.end(); }
+        const_iterator begin() const { return items_.begin(); }
+        const_iterator end() const { return items_.end(); }
+
+        size_t size() const { return items_.size(); }
+        bool empty() const { return items_.empty(); }
+        size_t capacity() const { return items_.capacity(); }
+        void reserve(size_t count) { items_.reserve(count); }
+
+        iterator find(std::string_view key);
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+
+        // Как у std::map: при отсутствии ключа выбрасывает std::out_of_range
+        Node& at(std::string_view key);
+        const Node& at(std::string_view key) const;
+        Node& operator[](std::string_view key);
+
+        // Вставляет пару, если ключа ещё нет; иначе возвращает существующую
+        template <typename... Args>
+        std::pair<iterator, bool> try_emplace(std::string key, Args&&... args);
+        std::pair<iterator, bool> emplace(std::string key, Node value);
+
+        bool operator==(const Dict& rhs) const;
+        bool operator!=(const Dict& rhs) const { return !(*this == rhs); }
+
+    private:
+        iterator LowerBound(std::string_view key);
+        const_iterator LowerBound(std::string_view key) const;
+
+        Items items_;
+    };
 
     class ParsingError : public std::runtime_error {
     public:
@@ -26,6 +90,21 @@ namespace json {
 
         explicit Node(Value value) : variant(std::move(value)) {}
 
+        Node(const Node&) = default;
+        Node(Node&&) = default;
+        Node& operator=(const Node&) = default;
+
+        // Массив или словарь переходит вместе со своей ареной. Обычное присваивание
+        // vector при разных аренах переложило бы элементы в арену приёмника,
+        // и они освободились бы вместе с чужой ареной
+        Node& operator=(Node&& other) noexcept {
+            if (this != &other) {
+                GetValue() = nullptr;
+                GetValue() = std::move(other.GetValue());
+            }
+            return *this;
+        }
+
         bool IsInt() const {
             return std::holds_alternative<int>(*this);
         }
@@ -112,17 +191,134 @@ namespace json {
         return !(lhs == rhs);
     }
 
+    inline Dict::Dict(std::initializer_list<value_type> items)
+        : Dict(Items(items)) {
+    }
+
+    inline Dict::Dict(Items items)
+        : items_(std::move(items)) {
+        using namespace std::literals;
+        auto less = [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first < rhs.first;
+        };
+        if (!std::is_sorted(items_.begin(), items_.end(), less)) {
+            std::sort(items_.begin(), items_.end(), less);
+        }
+        auto equal = [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first == rhs.first;
+        };
+        if (auto it = std::adjacent_find(items_.begin(), items_.end(), equal); it != items_.end()) {
+            throw std::logic_error("Duplicate key '"s + it->first + "'"s);
+        }
+    }
+
+    inline Dict::iterator Dict::LowerBound(std::string_view key) {
+        return std::lower_bound(items_.begin(), items_.end(), key,
+                                [](const value_type& item, std::string_view key) {
+                                    return item.first < key;
+                                });
+    }
+
+    inline Dict::const_iterator Dict::LowerBound(std::string_view key) const {
+        return std::lower_bound(items_.begin(), items_.end(), key,
+                                [](const value_type& item, std::string_view key) {
+                                    return item.first < key;
+                                });
+    }
+
+    inline Dict::iterator Dict::find(std::string_view key) {
+        auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+
+    inline Dict::const_iterator Dict::find(std::string_view key) const {
+        auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+
+    inline size_t Dict::count(std::string_view key) const {
+        return find(key) != items_.end() ? 1 : 0;
+    }
+
+    inline Node& Dict::at(std::string_view key) {
+        using namespace std::literals;
+        auto it = find(key);
+        if (it == items_.end()) {
+            throw std::out_of_range("No key '"s + std::string(key) + "'"s);
+        }
+        return it->second;
+    }
+
+    inline const Node& Dict::at(std::string_view key) const {
+        using namespace std::literals;
+        auto it = find(key);
+        if (it == items_.end()) {
+            throw std::out_of_range("No key '"s + std::string(key) + "'"s);
+        }
+        return it->second;
+    }
+
+    inline Node& Dict::operator[](std::string_view key) {
+        auto it = LowerBound(key);
+        if (it == items_.end() || it->first != key) {
+            it = items_.emplace(it, std::string(key), Node{});
+        }
+        return it->second;
+    }
+
+    template <typename... Args>
+    std::pair<Dict::iterator, bool> Dict::try_emplace(std::string key, Args&&... args) {
+        auto it = LowerBound(key);
+        if (it != items_.end() && it->first == key) {
+            return { it, false };
+        }
+        it = items_.emplace(it, std::piecewise_construct,
+                            std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+        return { it, true };
+    }
+
+    inline std::pair<Dict::iterator, bool> Dict::emplace(std::string key, Node value) {
+        return try_emplace(std::move(key), std::move(value));
+    }
+
+    inline bool Dict::operator==(const Dict& rhs) const {
+        return items_ == rhs.items_;
+    }
+
+    // Арены разобранного документа. Значение каждого ключа корневого словаря
+    // получает свою арену, чтобы его можно было освободить отдельно
+    struct DocumentMemory {
+        std::pmr::monotonic_buffer_resource root;
+        std::map<std::string, std::pmr::monotonic_buffer_resource, std::less<>> members;
+    };
+
+    // Документ, полученный из Load, владеет ареной, в которой лежат его массивы и словари:
+    // они освобождаются все сразу вместе с документом. Строки короче 16 символов
+    // хранятся внутри узлов, длинные — в обычной куче.
+    // Копии узлов документа размещаются в куче и от него не зависят
     class Document {
     public:
         explicit Document(Node root)
             : root_(std::move(root)) {
         }
 
+        Document(Node root, std::unique_ptr<DocumentMemory> memory)
+            : memory_(std::move(memory))
+            , root_(std::move(root)) {
+        }
+
         const Node& GetRoot() const {
             return root_;
         }
 
+        // Освобождает значение ключа корневого словаря, когда оно больше не нужно.
+        // Вместо массива или словаря остаётся пустой, вместо прочих значений — null
+        void Release(std::string_view key);
+
     private:
+        // Арена объявлена раньше корня, чтобы пережить его
+        std::unique_ptr<DocumentMemory> memory_;
         Node root_;
     };
 
@@ -134,8 +330,194 @@ namespace json {
         return !(lhs == rhs);
     }
 
+    // Разбирает документ из буфера; данные после корневого значения игнорируются
+    Document Load(std::string_view input);
+    // Читает поток блоками по мере разбора; прочитанное сверх корневого значения теряется
     Document Load(std::istream& input);
 
+    class Parser;
+
+    // Чтение значения прямо из разбираемого входа, без построения Node. Словари и массивы
+    // читаются по шагам: после StartDict() NextKey() выдаёт ключи, пока словарь не кончится,
+    // и после каждого ключа значение нужно прочитать одним из методов Read* или Skip().
+    // Грамматика и ошибки разбора — как у Load; значение другого типа даёт std::logic_error,
+    // как As* у Node. Повторяющиеся ключи не проверяются
+    class ValueReader {
+    public:
+        void StartDict();
+        // false, когда словарь закончился. Ключ действителен до следующего чтения
+        bool NextKey(std::string_view& key);
+        void StartArray();
+        // false, когда массив закончился
+        bool NextElement();
+
+        // Строка действительна до следующего чтения
+        std::string_view ReadString();
+        int ReadInt();
+        double ReadDouble();
+        bool ReadBool();
+        // Значение целиком, в арене элемента
+        Node ReadNode();
+        void Skip();
+
+    private:
+        friend class Parser;
+
+        explicit ValueReader(Parser& parser)
+            : parser_(parser) {
+        }
+
+        Parser& parser_;
+    };
+
+    // Обработчики элементов массивов корневого словаря, по ключу словаря.
+    // Обработчик читает ровно один элемент; прочитанное действительно только во время вызова
+    using StreamingHandlers = std::map<std::string, std::function<void(ValueReader& element)>, std::less<>>;
+
+    // Как Load, но массивы под ключами из handlers не сохраняются в документе:
+    // каждый элемент читается обработчиком прямо из входа, а под ключом
+    // остаётся пустой массив. Так большой массив не держится в памяти целиком:
+    // арена элемента освобождается, как только обработчик вернёт управление
+    Document LoadStreaming(std::istream& input, const StreamingHandlers& handlers);
+
+    // precision в PrintSettings: кратчайшая запись, которая читается обратно в то же число
+    inline constexpr int SHORTEST_PRECISION = 0;
+
+    // Формат вывода: текст JSON или двоичный MessagePack (см. msgpack.h)
+    enum class Encoding {
+        JSON,
+        MESSAGE_PACK,
+    };
+
+    struct PrintSettings {
+        Encoding encoding = Encoding::JSON;
+        // Без пробелов и переводов строк; для MessagePack не важно
+        bool compact = false;
+        int indent_step = 4;
+        // Число значащих цифр double, как у std::ostream::precision, или SHORTEST_PRECISION
+        int precision = 6;
+    };
+
+    // Выводит документ с отступами; double — с точностью потока, как operator<<
     void Print(const Document& doc, std::ostream& output);
+    // Вывод копится в буфере и уходит в поток блоками по 64 КБ
+    void Print(const Document& doc, std::ostream& output, const PrintSettings& settings);
+
+    // Буфер вывода JSON. С потоком данные уходят в него крупными блоками, когда буфер
+    // заполнен, и при Flush(); без потока буфер растёт и хранит весь вывод
+    class OutputBuffer {
+    public:
+        OutputBuffer();
+        explicit OutputBuffer(std::ostream& out);
+
+        void Put(char c) {
+            if (size_ == buffer_.size()) {
+                MakeRoom(1);
+            }
+            buffer_[size_++] = c;
+        }
+
+        void Write(std::string_view text);
+
+        // format(first, last) пишет число в [first, last) и возвращает конец записи
+        template <typename Format>
+        void WriteNumber(Format format) {
+            if (buffer_.size() - size_ < MAX_NUMBER_SIZE) {
+                MakeRoom(MAX_NUMBER_SIZE);
+            }
+            char* const begin = buffer_.data() + size_;
+            size_ += format(begin, begin + MAX_NUMBER_SIZE) - begin;
+        }
+
+        void Flush();
+
+        // Данные, ещё не отправленные в поток
+        std::string_view GetData() const {
+            return { buffer_.data(), size_ };
+        }
+
+        void Clear() {
+            size_ = 0;
+        }
+
+        // Отбрасывает данные после первых size байт; отправленные в поток не возвращаются
+        void Truncate(size_t size) {
+            size_ = std::min(size, size_);
+        }
+
+        // Заменяет count байт с позиции pos на bytes, не длиннее count; хвост сдвигается.
+        // Позиция считается от начала GetData(), так что заменить можно только то,
+        // что ещё не отправлено в поток
+        void Replace(size_t pos, size_t count, std::string_view bytes);
+
+    private:
+        static constexpr size_t INITIAL_SIZE = 1 << 16;
+        // Хватает на любое int и double в формате %g с точностью до 17 знаков
+        // и на кратчайшую запись double
+        static constexpr size_t MAX_NUMBER_SIZE = 64;
+
+        void MakeRoom(size_t count);
+
+        std::ostream* out_ = nullptr;
+        std::string buffer_;
+        size_t size_ = 0;
+    };
+
+    // Части вывода Print, для тех, кто печатает JSON без построения Node
+    void PrintString(std::string_view value, OutputBuffer& out);
+    void PrintNumber(int value, OutputBuffer& out);
+    void PrintNumber(double value, int precision, OutputBuffer& out);
+    // indent — отступ строки, на которой начинается значение
+    void PrintNode(const Node& node, OutputBuffer& out, const PrintSettings& settings, int indent);
+    // Строковое значение, закодированное как в выводе: JSON-строка в кавычках
+    // с экранированием или строка MessagePack вместе с заголовком
+    std::string EncodeString(std::string_view value, Encoding encoding);
+
+    // Выводит массив по одному элементу, не собирая его целиком. Результат совпадает
+    // с Print для всего массива с теми же настройками. Каждый элемент уходит в поток
+    // сразу после записи. В MessagePack размер массива стоит в заголовке,
+    // поэтому его нужно сообщить SetSize() до первого элемента
+    class ArrayWriter {
+    public:
+        ArrayWriter(std::ostream& output, const PrintSettings& settings);
+
+        // Число элементов, которые будут записаны; для JSON необязательно
+        void SetSize(size_t size);
+
+        void Write(const Node& element);
+        // Элемент, уже напечатанный с настройками GetSettings() и отступом GetElementIndent()
+        void WriteSerialized(std::string_view element);
+
+        // Элемент можно напечатать и прямо в буфер: StartElement() выводит разделитель
+        // и возвращает буфер, EndElement() отправляет напечатанное в поток
+        OutputBuffer& StartElement();
+        void EndElement();
+
+        const PrintSettings& GetSettings() const {
+            return settings_;
+        }
+
+        int GetElementIndent() const {
+            return settings_.indent_step;
+        }
+
+        // Закрывает массив; после этого писать нельзя. В MessagePack проверяет,
+        // что записано столько элементов, сколько обещано в SetSize()
+        void Finish();
+
+    private:
+        bool IsMessagePack() const {
+            return settings_.encoding == Encoding::MESSAGE_PACK;
+        }
+
+        PrintSettings settings_;
+        OutputBuffer buffer_;
+        // MessagePack: элемент копится отдельно, чтобы StreamBuilder мог дописать
+        // заголовки вложенных массивов и словарей, когда станет известен их размер
+        OutputBuffer element_buffer_;
+        bool empty_ = true;
+        std::optional<size_t> size_;
+        size_t count_ = 0;
+    };
 
 }  // namespace json
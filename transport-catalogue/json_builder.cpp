@@ -1,4 +1,5 @@
 #include "json_builder.h"
+#include "msgpack.h"
 
 namespace json {
 
@@ -8,7 +9,7 @@ namespace json {
         nodes_stack_.push_back(nullptr);
     }
 
-    Node Builder::Build() {
+    Node Builder::Build() & {
         if (nodes_stack_.size() > 1) {
             throw std::logic_error("Building incomplete JSON");
         }
@@ -19,6 +20,19 @@ namespace json {
         return *nodes_stack_.front();
     }
 
+    Node Builder::Build() && {
+        if (nodes_stack_.size() > 1) {
+            throw std::logic_error("Building incomplete JSON");
+        }
+        if (nodes_stack_.front() == nullptr) {
+            return Node(nullptr);
+        }
+        Node result = std::move(root_);
+        root_ = Node(nullptr);
+        nodes_stack_.front() = nullptr;
+        return result;
+    }
+
     Node::Value& Builder::GetCurrentValue() {
         if (nodes_stack_.empty() || !nodes_stack_.back()) {
             throw std::logic_error("No current value available");
@@ -162,4 +176,231 @@ namespace json {
         return BaseContext(*this);
     }
 
+    StreamBuilder::StreamBuilder(OutputBuffer& out, const PrintSettings& settings, int indent)
+        : out_(out)
+        , settings_(settings)
+        , indent_(indent) {
+    }
+
+    void StreamBuilder::Reset() {
+        depth_ = 0;
+        complete_ = false;
+    }
+
+    bool StreamBuilder::IsComplete() const {
+        return complete_;
+    }
+
+    void StreamBuilder::PrintIndent(size_t depth) {
+        if (!settings_.compact && !IsMessagePack()) {
+            const size_t width = static_cast<size_t>(indent_) + depth * static_cast<size_t>(settings_.indent_step);
+            for (size_t i = 0; i < width; ++i) {
+                out_.Put(' ');
+            }
+        }
+    }
+
+    void StreamBuilder::PrintLineBreak() {
+        if (!settings_.compact && !IsMessagePack()) {
+            out_.Put('\n');
+        }
+    }
+
+    void StreamBuilder::BeforeValue() {
+        if (depth_ == 0) {
+            if (complete_) {
+                throw std::logic_error("Value() called after the document is complete");
+            }
+            return;
+        }
+        Level& level = levels_[depth_ - 1];
+        if (level.is_dict) {
+            if (!level.has_key) {
+                throw std::logic_error("Value() called without Key()");
+            }
+            level.has_key = false;
+            return;
+        }
+        ++level.count;
+        if (!level.is_empty && !IsMessagePack()) {
+            out_.Put(',');
+            PrintLineBreak();
+        }
+        level.is_empty = false;
+        PrintIndent(depth_);
+    }
+
+    void StreamBuilder::AfterValue() {
+        if (depth_ == 0) {
+            complete_ = true;
+        }
+    }
+
+    void StreamBuilder::Open(bool is_dict) {
+        BeforeValue();
+        if (depth_ == levels_.size()) {
+            levels_.emplace_back();
+        }
+        Level& level = levels_[depth_++];
+        level.is_dict = is_dict;
+        level.is_empty = true;
+        level.has_key = false;
+        level.count = 0;
+        if (IsMessagePack()) {
+            level.header_pos = out_.GetData().size();
+            out_.Write(std::string_view(msgpack::ContainerHeader{}.bytes, msgpack::MAX_HEADER_SIZE));
+            return;
+        }
+        out_.Put(is_dict ? '{' : '[');
+        PrintLineBreak();
+    }
+
+    void StreamBuilder::Close(bool is_dict) {
+        if (depth_ == 0 || levels_[depth_ - 1].is_dict != is_dict || levels_[depth_ - 1].has_key) {
+            throw std::logic_error(is_dict ? "EndDict() called without matching StartDict()"
+                                           : "EndArray() called without matching StartArray()");
+        }
+        --depth_;
+        if (IsMessagePack()) {
+            const Level& level = levels_[depth_];
+            const msgpack::ContainerHeader header = is_dict ? msgpack::MakeMapHeader(level.count)
+                                                            : msgpack::MakeArrayHeader(level.count);
+            out_.Replace(level.header_pos, msgpack::MAX_HEADER_SIZE, header.Get());
+            AfterValue();
+            return;
+        }
+        PrintLineBreak();
+        PrintIndent(depth_);
+        out_.Put(is_dict ? '}' : ']');
+        AfterValue();
+    }
+
+    StreamBuilder::DictValueContext StreamBuilder::Key(std::string_view key) {
+        if (depth_ == 0 || !levels_[depth_ - 1].is_dict || levels_[depth_ - 1].has_key) {
+            throw std::logic_error("Key() called outside of dictionary");
+        }
+        Level& level = levels_[depth_ - 1];
+        if (!level.is_empty) {
+            if (key <= level.last_key) {
+                throw std::logic_error("Keys must be written in ascending order");
+            }
+            if (!IsMessagePack()) {
+                out_.Put(',');
+                PrintLineBreak();
+            }
+        }
+        level.is_empty = false;
+        level.has_key = true;
+        ++level.count;
+        // assign переиспользует память строки
+        level.last_key.assign(key.data(), key.size());
+
+        if (IsMessagePack()) {
+            msgpack::WriteString(key, out_);
+            return DictValueContext(*this);
+        }
+
+        PrintIndent(depth_);
+        PrintString(key, out_);
+        out_.Write(settings_.compact ? std::string_view(":") : std::string_view(": "));
+        return DictValueContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(std::nullptr_t) {
+        BeforeValue();
+        if (IsMessagePack()) {
+            msgpack::WriteNil(out_);
+        } else {
+            out_.Write("null");
+        }
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(bool value) {
+        BeforeValue();
+        if (IsMessagePack()) {
+            msgpack::WriteBool(value, out_);
+        } else {
+            out_.Write(value ? std::string_view("true") : std::string_view("false"));
+        }
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(int value) {
+        BeforeValue();
+        if (IsMessagePack()) {
+            msgpack::WriteInt(value, out_);
+        } else {
+            PrintNumber(value, out_);
+        }
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(double value) {
+        BeforeValue();
+        if (IsMessagePack()) {
+            msgpack::WriteDouble(value, out_);
+        } else {
+            PrintNumber(value, settings_.precision, out_);
+        }
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(std::string_view value) {
+        BeforeValue();
+        if (IsMessagePack()) {
+            msgpack::WriteString(value, out_);
+        } else {
+            PrintString(value, out_);
+        }
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(const char* value) {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(const std::string& value) {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(const Node& value) {
+        BeforeValue();
+        PrintNode(value, out_, settings_, indent_ + static_cast<int>(depth_) * settings_.indent_step);
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::Value(EncodedValue value) {
+        BeforeValue();
+        out_.Write(value.bytes);
+        AfterValue();
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::DictItemContext StreamBuilder::StartDict() {
+        Open(true);
+        return DictItemContext(*this);
+    }
+
+    StreamBuilder::ArrayItemContext StreamBuilder::StartArray() {
+        Open(false);
+        return ArrayItemContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::EndDict() {
+        Close(true);
+        return BaseContext(*this);
+    }
+
+    StreamBuilder::BaseContext StreamBuilder::EndArray() {
+        Close(false);
+        return BaseContext(*this);
+    }
+
 } // namespace json
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "json.h"
 
@@ -15,7 +16,10 @@ private:
 
 public:
     Builder();
-    Node Build();
+    // Копия готового документа; builder можно продолжать использовать
+    Node Build() &;
+    // Забирает готовый документ без копирования; builder становится пустым
+    Node Build() &&;
     DictValueContext Key(std::string key);
     BaseContext Value(Node::Value value);
     DictItemContext StartDict();
@@ -39,8 +43,9 @@ private:
     class BaseContext {
     public:
         BaseContext(Builder& builder) : builder_(builder) {}
+        // Цепочка вызовов заканчивается на Build(), поэтому документ забирается из builder
         Node Build() {
-            return builder_.Build();
+            return std::move(builder_).Build();
         }
         DictValueContext Key(std::string key) {
             return builder_.Key(std::move(key));
@@ -94,4 +99,140 @@ private:
     };
 };
 
+// Значение, уже закодированное в формате вывода (см. EncodeString).
+// StreamBuilder копирует его байты без разбора и экранирования
+struct EncodedValue {
+    std::string_view bytes;
+};
+
+// Builder с тем же контролем порядка вызовов, который сразу печатает документ
+// в OutputBuffer в формате Print, не строя Node. Print выводит ключи словаря
+// по возрастанию, поэтому и здесь они должны идти по возрастанию, иначе
+// std::logic_error. Память стека уровней переиспользуется между документами.
+// В MessagePack размер массива или словаря пишется перед элементами: под него
+// оставляется место, а при закрытии туда ставится заголовок нужной длины. Поэтому
+// начатый документ не должен уходить в поток — нужен буфер без потока
+class StreamBuilder {
+private:
+    class BaseContext;
+    class DictValueContext;
+    class DictItemContext;
+    class ArrayItemContext;
+
+public:
+    // indent — отступ строки, на которой начинается документ
+    StreamBuilder(OutputBuffer& out, const PrintSettings& settings, int indent = 0);
+
+    // Начинает следующий документ в том же буфере
+    void Reset();
+    bool IsComplete() const;
+    Encoding GetEncoding() const {
+        return settings_.encoding;
+    }
+
+    DictValueContext Key(std::string_view key);
+    BaseContext Value(std::nullptr_t);
+    BaseContext Value(bool value);
+    BaseContext Value(int value);
+    BaseContext Value(double value);
+    BaseContext Value(std::string_view value);
+    BaseContext Value(const char* value);
+    BaseContext Value(const std::string& value);
+    // Готовое поддерево печатается как есть
+    BaseContext Value(const Node& value);
+    // Кодировка значения должна совпадать с settings.encoding
+    BaseContext Value(EncodedValue value);
+    DictItemContext StartDict();
+    ArrayItemContext StartArray();
+    BaseContext EndDict();
+    BaseContext EndArray();
+
+private:
+    struct Level {
+        bool is_dict = false;
+        bool is_empty = true;
+        // В словаре после Key() ожидается значение
+        bool has_key = false;
+        std::string last_key;
+        // MessagePack: где в буфере место под заголовок и сколько в уровне элементов
+        size_t header_pos = 0;
+        size_t count = 0;
+    };
+
+    bool IsMessagePack() const {
+        return settings_.encoding == Encoding::MESSAGE_PACK;
+    }
+
+    // Разделитель и отступ перед значением на текущем уровне
+    void BeforeValue();
+    void AfterValue();
+    void Open(bool is_dict);
+    void Close(bool is_dict);
+    void PrintIndent(size_t depth);
+    void PrintLineBreak();
+
+    OutputBuffer& out_;
+    const PrintSettings& settings_;
+    const int indent_;
+    // Уровни [0, depth_) открыты; остальные хранятся ради памяти их строк
+    std::vector<Level> levels_;
+    size_t depth_ = 0;
+    bool complete_ = false;
+
+    class BaseContext {
+    public:
+        BaseContext(StreamBuilder& builder) : builder_(builder) {}
+        DictValueContext Key(std::string_view key) {
+            return builder_.Key(key);
+        }
+        template <typename T>
+        BaseContext Value(const T& value) {
+            return builder_.Value(value);
+        }
+        DictItemContext StartDict() {
+            return builder_.StartDict();
+        }
+        ArrayItemContext StartArray() {
+            return builder_.StartArray();
+        }
+        BaseContext EndDict() {
+            return builder_.EndDict();
+        }
+        BaseContext EndArray() {
+            return builder_.EndArray();
+        }
+    private:
+        StreamBuilder& builder_;
+    };
+
+    class DictValueContext : public BaseContext {
+    public:
+        DictValueContext(BaseContext base) : BaseContext(base) {}
+        template <typename T>
+        DictItemContext Value(const T& value) { return BaseContext::Value(value); }
+        DictValueContext Key(std::string_view key) = delete;
+        BaseContext EndDict() = delete;
+        BaseContext EndArray() = delete;
+    };
+
+    class DictItemContext : public BaseContext {
+    public:
+        DictItemContext(BaseContext base) : BaseContext(base) {}
+        template <typename T>
+        BaseContext Value(const T& value) = delete;
+        BaseContext EndArray() = delete;
+        DictItemContext StartDict() = delete;
+        ArrayItemContext StartArray() = delete;
+    };
+
+    class ArrayItemContext : public BaseContext {
+    public:
+        ArrayItemContext(BaseContext base) : BaseContext(base) {}
+        template <typename T>
+        ArrayItemContext Value(const T& value) { return BaseContext::Value(value); }
+        DictValueContext Key(std::string_view key) = delete;
+        BaseContext EndDict() = delete;
+    };
+};
+
 }  // namespace json
@@ -1,77 +1,433 @@
 #include "json_reader.h"
+#include "metrics.h"
+#include "msgpack.h"
 
 #include <algorithm>
+#include <atomic>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 
 using namespace std;
 
-JsonReader::JsonReader(transport_catalogue::TransportCatalogue& db) : db_(db) {}
+namespace {
 
-void JsonReader::ParseBaseRequests(const json::Node& root) {
-    const auto& base_requests = root.AsDict().at("base_requests").AsArray();
+    // stat_requests документа без этого ключа
+    const json::Array NO_STAT_REQUESTS;
 
-    for (const auto& req : base_requests) {      // Сначала добавляем все остановки
-        const auto& map = req.AsDict();
-        if (map.at("type").AsString() == "Stop") {
-            ParseStop(map);
+    // Map и Route обрабатываются намного дольше остальных запросов
+    bool IsExpensiveRequest(const json::Dict& map) {
+        const auto it = map.find("type");
+        if (it == map.end() || !it->second.IsString()) {
+            return false;
         }
+        const string& type = it->second.AsString();
+        return type == "Map"sv || type == "Route"sv;
     }
 
-    for (const auto& req : base_requests) {      // Затем добавляем расстояния между остановками
-        const auto& map = req.AsDict();
-        if (map.at("type").AsString() == "Stop" && map.count("road_distances")) {
-            ParseDistances(map);
+    // Ответ на Route и Stats (в нём память роутера) нельзя дать, пока не построен роутер
+    bool NeedsRouter(const json::Dict& map) {
+        const auto it = map.find("type");
+        if (it == map.end() || !it->second.IsString()) {
+            return false;
         }
+        const string& type = it->second.AsString();
+        return type == "Route"sv || type == "Stats"sv;
     }
 
-    for (const auto& req : base_requests) {      // После этого обрабатываем маршруты
+    // Для обработчиков, у которых всё готово сразу
+    const auto NEVER_WAIT = [](const json::Dict&) {
+        return false;
+    };
+
+    // Сколько запросов на поток отвечается заранее за одну проверку, не готов ли роутер
+    constexpr size_t EARLY_BATCH_PER_THREAD = 64;
+    // Насколько запросов и байт готовых ответов ранняя фаза может уйти вперёд вывода, пока
+    // роутер строится. Дальше заранее ничего не отвечается: ответы дождутся роутера, а не займут память
+    constexpr size_t EARLY_WINDOW = 64 * 1024;
+    constexpr size_t EARLY_BYTES_BUDGET = 8 * 1024 * 1024;
+
+    // Всё, от чего зависит ответ на запрос, кроме id; пустая строка — запрос ни с чем не объединяется.
+    // Поля, которых нет или которые не строки, оставляют запрос отдельным: ошибка в нём
+    // должна появиться там же, где и без планирования
+    string MakeQueryKey(const json::Dict& map) {
+        auto append = [&map](string_view field, string& key) {
+            const auto it = map.find(field);
+            if (it == map.end() || !it->second.IsString()) {
+                return false;
+            }
+            key += it->second.AsString();
+            key += '\0';
+            return true;
+        };
+
+        string key;
+        if (!append("type"sv, key)) {
+            return {};
+        }
+        const string_view type = string_view(key).substr(0, key.size() - 1);
+        bool known = true;
+        if (type == "Bus"sv || type == "Stop"sv) {
+            known = append("name"sv, key);
+        }
+        else if (type == "Route"sv) {
+            known = append("from"sv, key) && append("to"sv, key);
+        }
+        else {
+            // Map не объединяется: карта уже хранится закодированной в кэше обработчика,
+            // и копия готовых байт дешевле, чем захват ответа группы и его повторная печать
+            known = false;
+        }
+        // Ответ для нескольких городов зависит ещё и от города
+        if (!known || (map.count("city") && !append("city"sv, key))) {
+            return {};
+        }
+        return key;
+    }
+
+    // Ответы групп одинаковых запросов сохраняются в MessagePack: он разбирается
+    // обратно без потери точности, и ответ выводится так же, как без планирования
+    json::PrintSettings MakeCaptureSettings() {
+        json::PrintSettings settings;
+        settings.encoding = json::Encoding::MESSAGE_PACK;
+        return settings;
+    }
+
+    const json::PrintSettings CAPTURE_SETTINGS = MakeCaptureSettings();
+
+    // Поля запросов Stop и Bus в base_requests, по битам
+    enum BaseRequestField : unsigned {
+        UNKNOWN_FIELD = 0,
+        TYPE_FIELD = 1 << 0,
+        NAME_FIELD = 1 << 1,
+        LATITUDE_FIELD = 1 << 2,
+        LONGITUDE_FIELD = 1 << 3,
+        ROAD_DISTANCES_FIELD = 1 << 4,
+        STOPS_FIELD = 1 << 5,
+        IS_ROUNDTRIP_FIELD = 1 << 6,
+    };
+
+    // Известные ключи различаются длиной, поэтому хватает switch по длине
+    // и одного сравнения строк, а не поиска по словарю
+    constexpr BaseRequestField FindBaseRequestField(string_view key) {
+        switch (key.size()) {
+            case 4:
+                return key == "type"sv ? TYPE_FIELD : key == "name"sv ? NAME_FIELD : UNKNOWN_FIELD;
+            case 5:
+                return key == "stops"sv ? STOPS_FIELD : UNKNOWN_FIELD;
+            case 8:
+                return key == "latitude"sv ? LATITUDE_FIELD : UNKNOWN_FIELD;
+            case 9:
+                return key == "longitude"sv ? LONGITUDE_FIELD : UNKNOWN_FIELD;
+            case 12:
+                return key == "is_roundtrip"sv ? IS_ROUNDTRIP_FIELD : UNKNOWN_FIELD;
+            case 14:
+                return key == "road_distances"sv ? ROAD_DISTANCES_FIELD : UNKNOWN_FIELD;
+            default:
+                return UNKNOWN_FIELD;
+        }
+    }
+
+    static_assert(FindBaseRequestField("road_distances") == ROAD_DISTANCES_FIELD);
+    static_assert(FindBaseRequestField("names") == UNKNOWN_FIELD);
+
+    // Запрос Stop или Bus, прочитанный из входа. Ключи могут идти в любом порядке,
+    // поэтому запрос добавляется в каталог только целиком. Один экземпляр переиспользуется
+    // для всех запросов, и его строки и векторы не выделяют память заново.
+    // Имена остановок сразу копируются в пул загрузчика
+    struct BaseRequestRecord {
+        string type;
+        string name;
+        geo::Coordinates coordinates;
+        vector<pair<string_view, int>> distances;
+        vector<string_view> stops;
+        bool is_roundtrip = false;
+        // Прочитанные поля, по битам BaseRequestField
+        unsigned fields = 0;
+
+        void Require(BaseRequestField field, string_view key) const {
+            if ((fields & field) == 0) {
+                // Как у Dict::at
+                throw out_of_range("No key '"s + string(key) + "'"s);
+            }
+        }
+    };
+
+    void DecodeBaseRequest(json::ValueReader& reader, transport_catalogue::BulkLoader& loader,
+                           BaseRequestRecord& record) {
+        record.fields = 0;
+        record.distances.clear();
+        record.stops.clear();
+
+        reader.StartDict();
+        string_view key;
+        while (reader.NextKey(key)) {
+            const BaseRequestField field = FindBaseRequestField(key);
+            if (record.fields & field) {
+                throw json::ParsingError("Duplicate key '"s + string(key) + "' have been found"s);
+            }
+            record.fields |= field;
+            switch (field) {
+                case TYPE_FIELD:
+                    record.type = reader.ReadString();
+                    break;
+                case NAME_FIELD:
+                    record.name = reader.ReadString();
+                    break;
+                case LATITUDE_FIELD:
+                    record.coordinates.lat = reader.ReadDouble();
+                    break;
+                case LONGITUDE_FIELD:
+                    record.coordinates.lng = reader.ReadDouble();
+                    break;
+                case ROAD_DISTANCES_FIELD:
+                    reader.StartDict();
+                    while (reader.NextKey(key)) {
+                        const string_view to = loader.KeepName(key);
+                        record.distances.emplace_back(to, reader.ReadInt());
+                    }
+                    break;
+                case STOPS_FIELD:
+                    reader.StartArray();
+                    while (reader.NextElement()) {
+                        record.stops.push_back(loader.KeepName(reader.ReadString()));
+                    }
+                    break;
+                case IS_ROUNDTRIP_FIELD:
+                    record.is_roundtrip = reader.ReadBool();
+                    break;
+                case UNKNOWN_FIELD:
+                    reader.Skip();
+                    break;
+            }
+        }
+    }
+
+    void AddBaseRequest(BaseRequestRecord& record, transport_catalogue::BulkLoader& loader) {
+        record.Require(TYPE_FIELD, "type"sv);
+        if (record.type == "Stop"sv) {
+            record.Require(NAME_FIELD, "name"sv);
+            record.Require(LATITUDE_FIELD, "latitude"sv);
+            record.Require(LONGITUDE_FIELD, "longitude"sv);
+            const domain::Stop& stop = loader.AddStop(domain::Stop{ record.name, record.coordinates });
+
+            // Как в json::Dict: по возрастанию имени, без повторов
+            auto& distances = record.distances;
+            sort(distances.begin(), distances.end());
+            auto same_stop = [](const auto& lhs, const auto& rhs) {
+                return lhs.first == rhs.first;
+            };
+            if (auto it = adjacent_find(distances.begin(), distances.end(), same_stop); it != distances.end()) {
+                throw json::ParsingError("Duplicate key '"s + string(it->first) + "' have been found"s);
+            }
+            for (const auto& [to, distance] : distances) {
+                loader.AddDistance(stop.name, to, distance);
+            }
+        }
+        else if (record.type == "Bus"sv) {
+            record.Require(STOPS_FIELD, "stops"sv);
+            record.Require(NAME_FIELD, "name"sv);
+            record.Require(IS_ROUNDTRIP_FIELD, "is_roundtrip"sv);
+            loader.AddBus(record.name, record.stops, record.is_roundtrip);
+        }
+    }
+
+} // namespace
+
+JsonReader::JsonReader(transport_catalogue::TransportCatalogue& db)
+    : db_(db)
+    , stat_requests_(&NO_STAT_REQUESTS) {
+}
+
+template <typename Requests>
+void JsonReader::LoadBaseRequests(const Requests& base_requests, bool keep_names, ThreadPool* pool) {
+    size_t stop_count = 0;
+    size_t bus_count = 0;
+    size_t distance_count = 0;
+    for (const auto& req : base_requests) {
         const auto& map = req.AsDict();
-        if (map.at("type").AsString() == "Bus") {
-            ParseBus(map);
+        const auto& type = map.at("type").AsString();
+        if (type == "Stop") {
+            ++stop_count;
+            if (auto it = map.find("road_distances"); it != map.end()) {
+                distance_count += (*it).second.AsDict().size();
+            }
+        }
+        else if (type == "Bus") {
+            ++bus_count;
+        }
+    }
+
+    // Ссылки на остановки разрешаются в Finish(), поэтому порядок запросов не важен
+    transport_catalogue::BulkLoader loader(db_, stop_count, bus_count, distance_count);
+    for (const auto& req : base_requests) {
+        ParseBaseRequest(req.AsDict(), loader, keep_names);
+    }
+    loader.Finish(pool);
+}
+
+void JsonReader::ParseBaseRequests(const json::Node& root, ThreadPool* pool) {
+    LoadBaseRequests(root.AsDict().at("base_requests").AsArray(), false, pool);
+}
+
+json::Document JsonReader::LoadStreaming(std::istream& input, ThreadPool* pool) {
+    // Число объектов заранее неизвестно, контейнеры растут по мере разбора
+    transport_catalogue::BulkLoader loader(db_, 0, 0, 0);
+    BaseRequestRecord record;
+    json::Document doc = json::LoadStreaming(input, {
+        { "base_requests", [&loader, &record](json::ValueReader& request) {
+            // Поля читаются прямо из входа, без json::Dict
+            DecodeBaseRequest(request, loader, record);
+            AddBaseRequest(record, loader);
+        } },
+    });
+    loader.Finish(pool);
+    return doc;
+}
+
+json::Document JsonReader::LoadLazy(std::string_view input, ThreadPool* pool) {
+    const json::LazyDocument lazy(input);
+    const json::LazyDict root = lazy.GetRoot().AsDict();
+
+    // Буфер живёт до конца Finish(), поэтому имена не копируются
+    if (auto it = root.find("base_requests"); it != root.end()) {
+        LoadBaseRequests((*it).second.AsArray(), false, pool);
+    }
+
+    // Остальные ключи невелики и нужны целиком
+    json::Dict::Items items;
+    for (const auto [key, value] : root) {
+        items.emplace_back(std::string(key), key == "base_requests" ? json::Node(json::Array{}) : value.ToNode());
+    }
+    return json::Document(json::Node(json::Dict(std::move(items))));
+}
+
+template <typename Map>
+void JsonReader::ParseBaseRequest(const Map& map, transport_catalogue::BulkLoader& loader, bool keep_names) const {
+    const auto& type = map.at("type").AsString();
+    if (type == "Stop") {
+        const domain::Stop& stop = ParseStop(map, loader);
+        if (map.count("road_distances")) {
+            ParseDistances(map, stop.name, loader, keep_names);
         }
     }
+    else if (type == "Bus") {
+        ParseBus(map, loader, keep_names);
+    }
 }
 
 void JsonReader::ParseStatRequests(const json::Node& root) {
-    stat_requests_.clear();
-    
+    stat_requests_ = &NO_STAT_REQUESTS;
+
     if (auto it = root.AsDict().find("stat_requests"); it != root.AsDict().end()) {
-        stat_requests_ = it->second.AsArray();
+        stat_requests_ = &it->second.AsArray();
+    }
+
+    json_stats_.clear();
+    const bool has_stats = std::any_of(stat_requests_->begin(), stat_requests_->end(), [](const json::Node& req) {
+        return req.IsDict() && req.AsDict().count("type") && req.AsDict().at("type") == json::Node("Stats"s);
+    });
+    if (has_stats) {
+        // stat_requests входят в документ, отдельной копии у них нет
+        json_stats_.push_back(memory_stats::CollectJson("json.document", root));
     }
-}
 
-json::Node JsonReader::ProcessStatRequests(const RequestHandler& handler) const {
-    json::Array results;
+    PlanStatRequests();
+}
 
-    for (const auto& req : stat_requests_) {
+void JsonReader::PlanStatRequests() {
+    stat_plan_ = StatPlan{};
+    std::vector<std::string> keys;
+    std::unordered_map<std::string_view, size_t> counts;
+    for (const auto& req : *stat_requests_) {
         if (!req.IsDict()) continue;
+        keys.push_back(MakeQueryKey(req.AsDict()));
+    }
+    for (const std::string& key : keys) {
+        if (!key.empty()) {
+            ++counts[key];
+        }
+    }
 
+    // Номера групп — в порядке первых запросов
+    std::unordered_map<std::string_view, size_t> groups;
+    stat_plan_.groups.reserve(keys.size());
+    for (const std::string& key : keys) {
+        if (key.empty() || counts.at(key) < 2) {
+            stat_plan_.groups.push_back(StatPlan::UNIQUE);
+            ++stat_plan_.distinct_count;
+            continue;
+        }
+        const auto [it, inserted] = groups.emplace(key, stat_plan_.group_sizes.size());
+        if (inserted) {
+            stat_plan_.group_sizes.push_back(counts.at(key));
+            ++stat_plan_.distinct_count;
+        }
+        stat_plan_.groups.push_back(it->second);
+    }
+}
+
+std::vector<transport_catalogue::CatalogueUpdate> JsonReader::ParseUpdateRequests(const json::Node& root) const {
+    return ParseUpdateRequests(root.AsDict().at("update_requests").AsArray());
+}
+
+std::vector<transport_catalogue::CatalogueUpdate> JsonReader::ParseUpdateRequests(const json::Array& requests) const {
+    std::vector<transport_catalogue::CatalogueUpdate> updates;
+    // Как и в base_requests, расстояния могут ссылаться на остановки, идущие следом,
+    // поэтому они применяются после подряд идущих запросов Stop, но до следующего
+    // запроса другого типа: порядок пакета относительно удалений сохраняется
+    std::vector<transport_catalogue::CatalogueUpdate> distances;
+    auto flush_distances = [&updates, &distances]() {
+        updates.insert(updates.end(), std::make_move_iterator(distances.begin()), std::make_move_iterator(distances.end()));
+        distances.clear();
+    };
+
+    for (const auto& req : requests) {
         const auto& map = req.AsDict();
-        int id = map.at("id").AsInt();
         const std::string& type = map.at("type").AsString();
+        if (type != "Stop") {
+            flush_distances();
+        }
 
-        json::Builder builder;
-        builder.StartDict().Key("request_id").Value(id);
-
-        if (type == "Bus") {
-            ProcessBusRequest(map, handler, builder);
+        if (type == "Stop") {
+            const std::string& name = map.at("name").AsString();
+            updates.push_back(transport_catalogue::StopUpdate{
+                name, { map.at("latitude").AsDouble(), map.at("longitude").AsDouble() } });
+            if (auto it = map.find("road_distances"); it != map.end()) {
+                for (const auto& [to_name, dist_node] : it->second.AsDict()) {
+                    distances.push_back(transport_catalogue::DistanceUpdate{ name, to_name, dist_node.AsInt() });
+                }
+            }
+        }
+        else if (type == "Bus") {
+            transport_catalogue::BusUpdate update;
+            update.name = map.at("name").AsString();
+            for (const auto& stop_node : map.at("stops").AsArray()) {
+                update.stops.push_back(stop_node.AsString());
+            }
+            update.is_roundtrip = map.at("is_roundtrip").AsBool();
+            updates.push_back(std::move(update));
         }
-        else if (type == "Stop") {
-            ProcessStopRequest(map, handler, builder);
+        else if (type == "RemoveStop") {
+            updates.push_back(transport_catalogue::StopRemoval{ map.at("name").AsString() });
         }
-        else if (type == "Map") {
-            ProcessMapRequest(map, handler, builder);
+        else if (type == "RemoveBus") {
+            updates.push_back(transport_catalogue::BusRemoval{ map.at("name").AsString() });
         }
-
-        else if (type == "Route") {
-            ProcessRouteRequest(map, handler, builder);
+        else if (type == "RemoveDistance") {
+            updates.push_back(transport_catalogue::DistanceRemoval{ map.at("from").AsString(), map.at("to").AsString() });
         }
-        
-        builder.EndDict();
-        results.push_back(builder.Build());
     }
 
-    return json::Node(std::move(results));
+    flush_distances();
+    return updates;
 }
 
 map_renderer::RenderSettings JsonReader::ParseRenderSettings(const json::Node& root) const {
@@ -119,6 +475,19 @@ TransportRouter::RoutingSettings JsonReader::ParseRoutingSettings(const json::No
     return settings;
 }
 
+serialization::SerializationSettings JsonReader::ParseSerializationSettings(const json::Node& root) const {
+    serialization::SerializationSettings settings;
+    const auto& dict = root.AsDict().at("serialization_settings").AsDict();
+    settings.file = dict.at("file").AsString();
+    if (auto it = dict.find("image"); it != dict.end()) {
+        settings.image = it->second.AsString();
+    }
+    if (auto it = dict.find("delta_log"); it != dict.end()) {
+        settings.delta_log = it->second.AsString();
+    }
+    return settings;
+}
+
 svg::Color JsonReader::ParseColor(const json::Node& node) const {
     if (node.IsString()) {
         return node.AsString();
@@ -145,117 +514,500 @@ svg::Color JsonReader::ParseColor(const json::Node& node) const {
     return svg::NoneColor;
 }
 
-void JsonReader::ParseStop(const json::Dict& map) {
+template <typename Map>
+const domain::Stop& JsonReader::ParseStop(const Map& map, transport_catalogue::BulkLoader& loader) const {
     domain::Stop stop;
     stop.name = map.at("name").AsString();
     stop.coordinates.lat = map.at("latitude").AsDouble();
     stop.coordinates.lng = map.at("longitude").AsDouble();
-    db_.AddStop(stop);
+    return loader.AddStop(std::move(stop));
 }
 
-void JsonReader::ParseDistances(const json::Dict& map) {
+template <typename Map>
+void JsonReader::ParseDistances(const Map& map, std::string_view from,
+                                transport_catalogue::BulkLoader& loader, bool keep_names) const {
     const auto& distances = map.at("road_distances").AsDict();
-    const domain::Stop* from = db_.FindStop(map.at("name").AsString());
     for (const auto& [to_name, dist_node] : distances) {
-        const domain::Stop* to = db_.FindStop(to_name);
-        if (to) {
-            db_.SetDistance(from, to, dist_node.AsInt());
-        }
+        const std::string_view to = keep_names ? loader.KeepName(to_name) : std::string_view(to_name);
+        loader.AddDistance(from, to, dist_node.AsInt());
     }
 }
 
-void JsonReader::ParseBus(const json::Dict& map) {
-    domain::Bus bus;
-    bus.name = map.at("name").AsString();
-    bus.is_roundtrip = map.at("is_roundtrip").AsBool();
-
-    for (const auto& stop_node : map.at("stops").AsArray()) {
-        if (const domain::Stop* stop_ptr = db_.FindStop(stop_node.AsString())) {
-            bus.stops.push_back(stop_ptr);
-        }
+template <typename Map>
+void JsonReader::ParseBus(const Map& map, transport_catalogue::BulkLoader& loader, bool keep_names) const {
+    const auto& stops = map.at("stops").AsArray();
+    std::vector<std::string_view> stop_names;
+    stop_names.reserve(stops.size());
+    for (const auto& stop_node : stops) {
+        const std::string_view name = stop_node.AsString();
+        stop_names.push_back(keep_names ? loader.KeepName(name) : std::string_view(name));
     }
 
-    db_.AddBus(bus);
+    loader.AddBus(std::string(map.at("name").AsString()), std::move(stop_names), map.at("is_roundtrip").AsBool());
 }
 
-void JsonReader::ProcessBusRequest(const json::Dict& map,
-    const RequestHandler& handler,
-    json::Builder& builder) const {
-    std::string bus_name = map.at("name").AsString();
+template <typename Handler>
+void JsonReader::ProcessBusRequest(const json::Dict& map, int id,
+    const Handler& handler,
+    json::StreamBuilder& builder) const {
+    const std::string& bus_name = map.at("name").AsString();
     auto info_opt = handler.GetBusStat(bus_name);
 
     if (!info_opt) {
-        builder.Key("error_message").Value("not found");
+        builder.Key("error_message").Value("not found")
+            .Key("request_id").Value(id);
     }
     else {
         const auto& info = *info_opt;
-        builder.Key("stop_count").Value(info.stops_count)
-            .Key("unique_stop_count").Value(info.unique_stops_count)
+        builder.Key("curvature").Value(info.curvature)
+            .Key("request_id").Value(id)
             .Key("route_length").Value(info.route_length)
-            .Key("curvature").Value(info.curvature);
+            .Key("stop_count").Value(info.stops_count)
+            .Key("unique_stop_count").Value(info.unique_stops_count);
     }
 }
 
-void JsonReader::ProcessStopRequest(const json::Dict& map,
-    const RequestHandler& handler,
-    json::Builder& builder) const {
-    std::string stop_name = map.at("name").AsString();
-    const domain::Stop* stop = handler.FindStop(stop_name);
+template <typename Handler>
+void JsonReader::ProcessStopRequest(const json::Dict& map, int id,
+    const Handler& handler,
+    json::StreamBuilder& builder) const {
+    const std::string& stop_name = map.at("name").AsString();
+    const auto stop = handler.FindStop(stop_name);
 
     if (!stop) {
-        builder.Key("error_message").Value("not found");
+        builder.Key("error_message").Value("not found")
+            .Key("request_id").Value(id);
     }
     else {
-        const auto* buses = handler.GetBusesByStop(stop_name);
+        const auto buses = handler.GetBusesByStop(stop_name);
         builder.Key("buses").StartArray();
 
         if (buses) {
-            std::vector<std::string> sorted_buses(buses->begin(), buses->end());
-            std::sort(sorted_buses.begin(), sorted_buses.end());
-            for (const auto& bus_name : sorted_buses) {
+            // Список уже отсортирован каталогом
+            for (const std::string_view bus_name : *buses) {
                 builder.Value(bus_name);
             }
         }
 
-        builder.EndArray();
+        builder.EndArray().Key("request_id").Value(id);
     }
 }
 
-void JsonReader::ProcessMapRequest(const json::Dict& /*map*/,
-    const RequestHandler& handler,
-    json::Builder& builder) const {
-    std::ostringstream svg_stream;
-    handler.RenderMap().Render(svg_stream);
-    builder.Key("map").Value(svg_stream.str());
+template <typename Handler>
+void JsonReader::ProcessMapRequest(const json::Dict& /*map*/, int id,
+    const Handler& handler,
+    json::StreamBuilder& builder) const {
+    const auto encoded_map = handler.GetEncodedMap(builder.GetEncoding());
+    builder.Key("map").Value(json::EncodedValue{ *encoded_map })
+        .Key("request_id").Value(id);
 }
 
-void JsonReader::ProcessRouteRequest(const json::Dict& map,
-                                     const RequestHandler& handler,
-                                     json::Builder& builder) const {
-    const std::string from = map.at("from").AsString();
-    const std::string to = map.at("to").AsString();
+template <typename Handler>
+void JsonReader::ProcessRouteRequest(const json::Dict& map, int id,
+                                     const Handler& handler,
+                                     json::StreamBuilder& builder) const {
+    const std::string& from = map.at("from").AsString();
+    const std::string& to = map.at("to").AsString();
 
     auto route = handler.BuildRoute(from, to);
     if (!route) {
-        builder.Key("error_message").Value("not found");
+        builder.Key("error_message").Value("not found")
+               .Key("request_id").Value(id);
         return;
     }
 
-    builder.Key("total_time").Value(route->total_time)
-           .Key("items").StartArray();
+    builder.Key("items").StartArray();
 
     for (const auto& item : route->items) {
-        builder.StartDict().Key("type").Value(item.type);
+        builder.StartDict();
         if (item.type == "Wait") {
             builder.Key("stop_name").Value(item.name)
-                   .Key("time").Value(item.time);
+                   .Key("time").Value(item.time)
+                   .Key("type").Value(item.type);
         } else if (item.type == "Bus") {
             builder.Key("bus").Value(item.name)
                    .Key("span_count").Value(item.span_count)
-                   .Key("time").Value(item.time);
+                   .Key("time").Value(item.time)
+                   .Key("type").Value(item.type);
+        } else {
+            builder.Key("type").Value(item.type);
         }
         builder.EndDict();
     }
 
-    builder.EndArray();
+    builder.EndArray()
+           .Key("request_id").Value(id)
+           .Key("total_time").Value(route->total_time);
+}
+
+template <typename Handler>
+void JsonReader::ProcessStatsRequest(const json::Dict& /*map*/, int id,
+                                     const Handler& handler,
+                                     json::StreamBuilder& builder) const {
+    memory_stats::Report report = handler.GetMemoryStats();
+    report.insert(report.end(), json_stats_.begin(), json_stats_.end());
+    // Во сколько раз планирование сократило число вычисляемых ответов
+    const size_t request_count = stat_plan_.groups.size();
+    const size_t distinct_count = stat_plan_.distinct_count;
+    const double dedup_ratio = distinct_count > 0 ? static_cast<double>(request_count) / distinct_count : 1.0;
+    builder.Key("memory").Value(memory_stats::ReportToJson(report))
+           .Key("planner").StartDict()
+               .Key("dedup_ratio").Value(dedup_ratio)
+               .Key("distinct_requests").Value(static_cast<int>(distinct_count))
+               .Key("requests").Value(static_cast<int>(request_count))
+           .EndDict()
+           .Key("request_id").Value(id);
+}
+
+template <typename Handler>
+void JsonReader::ProcessStatRequest(const json::Dict& map, const Handler& handler, json::StreamBuilder& builder) const {
+    int id = map.at("id").AsInt();
+    const std::string& type = map.at("type").AsString();
+
+    builder.StartDict();
+
+    if (type == "Bus") {
+        TC_METRICS_SCOPE(BUS_REQUEST);
+        ProcessBusRequest(map, id, handler, builder);
+    }
+    else if (type == "Stop") {
+        TC_METRICS_SCOPE(STOP_REQUEST);
+        ProcessStopRequest(map, id, handler, builder);
+    }
+    else if (type == "Map") {
+        TC_METRICS_SCOPE(MAP_REQUEST);
+        ProcessMapRequest(map, id, handler, builder);
+    }
+
+    else if (type == "Route") {
+        TC_METRICS_SCOPE(ROUTE_REQUEST);
+        ProcessRouteRequest(map, id, handler, builder);
+    }
+    else if (type == "Stats") {
+        TC_METRICS_SCOPE(STATS_REQUEST);
+        ProcessStatsRequest(map, id, handler, builder);
+    }
+    else if (type == "Metrics") {
+        ProcessMetricsRequest(id, builder);
+    }
+    else {
+        builder.Key("request_id").Value(id);
+    }
+
+    builder.EndDict();
+}
+
+void JsonReader::ProcessMetricsRequest(int id, json::StreamBuilder& builder) const {
+#ifdef TC_METRICS
+    builder.Key("metrics").Value(metrics::ReportToJson());
+#else
+    builder.Key("error_message").Value("metrics are disabled");
+#endif
+    builder.Key("request_id").Value(id);
+}
+
+void JsonReader::ProcessCityRequest(const json::Dict& map, const CityRegistry& cities, json::StreamBuilder& builder) const {
+    const auto city = map.find("city");
+    const RequestHandler* handler = city != map.end() && city->second.IsString()
+        ? cities.FindHandler(city->second.AsString())
+        : nullptr;
+
+    if (handler) {
+        ProcessStatRequest(map, *handler, builder);
+        return;
+    }
+    builder.StartDict()
+        .Key("error_message").Value("not found")
+        .Key("request_id").Value(map.at("id").AsInt())
+        .EndDict();
+}
+
+void JsonReader::WriteSharedResponse(const json::Node& response, int id, json::StreamBuilder& builder) const {
+    builder.StartDict();
+    // Ключи словаря уже упорядочены, как того требует StreamBuilder
+    for (const auto& [key, value] : response.AsDict()) {
+        builder.Key(key);
+        if (key == "request_id") {
+            builder.Value(id);
+        } else {
+            builder.Value(value);
+        }
+    }
+    builder.EndDict();
+}
+
+template <typename Answer, typename MustWait>
+void JsonReader::WriteStatResponsesWith(json::ArrayWriter& writer, ThreadPool* pool,
+                                        const Answer& answer, const MustWait& must_wait) const {
+    std::vector<const json::Dict*> requests;
+    for (const auto& req : *stat_requests_) {
+        if (req.IsDict()) {
+            requests.push_back(&req.AsDict());
+        }
+    }
+    writer.SetSize(requests.size());
+
+    // Ответ группы вычисляется по первому её запросу и хранится, пока не выведен последний
+    const std::vector<size_t>& groups = stat_plan_.groups;
+    std::vector<std::shared_ptr<const json::Document>> shared(stat_plan_.group_sizes.size());
+    std::vector<size_t> remaining = stat_plan_.group_sizes;
+    std::vector<bool> is_follower(requests.size(), false);
+    {
+        std::vector<bool> seen(shared.size(), false);
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (groups[i] != StatPlan::UNIQUE) {
+                is_follower[i] = seen[groups[i]];
+                seen[groups[i]] = true;
+            }
+        }
+    }
+    auto capture = [&answer](const json::Dict& map) {
+        json::OutputBuffer out;
+        json::StreamBuilder builder(out, CAPTURE_SETTINGS);
+        answer(map, builder);
+        return std::make_shared<const json::Document>(msgpack::Load(out.GetData()));
+    };
+
+    // Один builder на ответы, которые печатает этот поток: его стек уровней выделяется один раз
+    std::optional<json::StreamBuilder> builder;
+    auto start_element = [&writer, &builder]() -> json::StreamBuilder& {
+        json::OutputBuffer& out = writer.StartElement();
+        if (!builder) {
+            builder.emplace(out, writer.GetSettings(), writer.GetElementIndent());
+        }
+        builder->Reset();
+        return *builder;
+    };
+    auto write_shared = [&](size_t index) {
+        const size_t group = groups[index];
+        WriteSharedResponse(shared[group]->GetRoot(), requests[index]->at("id").AsInt(), start_element());
+        writer.EndElement();
+        if (--remaining[group] == 0) {
+            shared[group].reset();
+        }
+    };
+
+    // Буфер вывода и builder переиспользуются задачами: их не больше, чем задач
+    // выполняется одновременно, то есть чем потоков в пуле
+    struct Scratch {
+        Scratch(const json::PrintSettings& settings, int indent)
+            : builder(out, settings, indent) {
+        }
+
+        json::OutputBuffer out;
+        json::StreamBuilder builder;
+    };
+    std::mutex scratch_mutex;
+    std::vector<std::unique_ptr<Scratch>> free_scratch;
+
+    auto answer_request = [&](const json::Dict& map) {
+        std::unique_ptr<Scratch> scratch;
+        {
+            std::lock_guard lock(scratch_mutex);
+            if (!free_scratch.empty()) {
+                scratch = std::move(free_scratch.back());
+                free_scratch.pop_back();
+            }
+        }
+        if (!scratch) {
+            scratch = std::make_unique<Scratch>(writer.GetSettings(), writer.GetElementIndent());
+        }
+        scratch->out.Clear();
+        scratch->builder.Reset();
+        answer(map, scratch->builder);
+        std::string response(scratch->out.GetData());
+
+        std::lock_guard lock(scratch_mutex);
+        free_scratch.push_back(std::move(scratch));
+        return response;
+    };
+
+    // Задача — отдельный запрос или первый запрос группы; остальные запросы группы
+    // не вычисляются, их ответы печатает главный поток
+    struct Response {
+        std::string text;
+        std::shared_ptr<const json::Document> shared;
+    };
+    auto compute = [&](size_t index) {
+        const json::Dict& map = *requests[index];
+        if (groups[index] == StatPlan::UNIQUE) {
+            return Response{ answer_request(map), nullptr };
+        }
+        return Response{ std::string(), capture(map) };
+    };
+    auto write_response = [&](size_t index, Response response) {
+        if (response.shared) {
+            shared[groups[index]] = std::move(response.shared);
+            write_shared(index);
+        } else {
+            writer.WriteSerialized(response.text);
+        }
+    };
+
+    // Пока часть запросов ждёт (например, строящийся роутер), остальные отвечаются
+    // заранее, пачками. Ответы до первого ждущего запроса выводятся сразу, а после него
+    // ждут своей очереди в памяти, пока их не больше EARLY_WINDOW запросов и EARLY_BYTES_BUDGET
+    // байт. Фаза кончается, как только ждать больше нечего или бюджет исчерпан. Ошибка в запросе хранится
+    // в его future и выводится в своё время
+    std::vector<std::future<Response>> responses(requests.size());
+    std::vector<bool> is_early(requests.size(), false);
+    size_t written = 0;
+    const auto first_waiting = std::find_if(requests.begin(), requests.end(), [&must_wait](const json::Dict* map) {
+        return must_wait(*map);
+    });
+    if (first_waiting != requests.end()) {
+        const size_t batch_size = EARLY_BATCH_PER_THREAD * (pool ? pool->GetThreadCount() + 1 : 1);
+        std::atomic<size_t> held_bytes{ 0 };
+        // Выводит готовые по порядку ответы; ведомый запрос группы готов вместе с первым
+        auto write_ready = [&]() {
+            for (; written < requests.size(); ++written) {
+                if (is_follower[written] && shared[groups[written]]) {
+                    write_shared(written);
+                    continue;
+                }
+                if (!is_early[written]) {
+                    break;
+                }
+                Response response = responses[written].get();
+                held_bytes -= response.text.size();
+                write_response(written, std::move(response));
+            }
+        };
+
+        std::vector<size_t> batch;
+        size_t next = 0;
+        while (next < requests.size() && must_wait(**first_waiting)
+               && next - written < EARLY_WINDOW && held_bytes < EARLY_BYTES_BUDGET) {
+            batch.clear();
+            for (; next < requests.size() && batch.size() < batch_size && next - written < EARLY_WINDOW; ++next) {
+                if (!is_follower[next] && !must_wait(*requests[next])) {
+                    batch.push_back(next);
+                }
+            }
+            ParallelFor(pool, batch.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    std::packaged_task<Response()> task([&compute, &held_bytes, index = batch[i]] {
+                        Response response = compute(index);
+                        held_bytes += response.text.size();
+                        return response;
+                    });
+                    responses[batch[i]] = task.get_future();
+                    task();
+                }
+            });
+            for (const size_t index : batch) {
+                is_early[index] = true;
+            }
+            write_ready();
+        }
+    }
+
+    if (!pool) {
+        for (size_t i = written; i < requests.size(); ++i) {
+            if (is_early[i]) {
+                write_response(i, responses[i].get());
+                continue;
+            }
+            const size_t group = groups[i];
+            if (group == StatPlan::UNIQUE) {
+                answer(*requests[i], start_element());
+                writer.EndElement();
+                continue;
+            }
+            if (!shared[group]) {
+                shared[group] = capture(*requests[i]);
+            }
+            write_shared(i);
+        }
+        writer.Finish();
+        return;
+    }
+
+    std::vector<size_t> expensive;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (!is_follower[i] && !is_early[i] && IsExpensiveRequest(*requests[i])) {
+            expensive.push_back(i);
+        }
+    }
+
+    // Буфер переупорядочивания: ответы выводятся в порядке запросов, даже если
+    // готовы раньше. Одновременно в работе не больше window запросов, чтобы
+    // готовые ответы (например, большие карты) не копились без ограничения.
+    // Дорогие запросы (Map, Route) запускаются раньше своей очереди и занимают
+    // до половины окна: иначе долгий запрос в конце задержал бы весь вывод
+    const size_t window = 2 * (pool->GetThreadCount() + 1);
+    size_t in_flight = 0;
+    auto submit = [&](size_t index) {
+        responses[index] = pool->Submit([&compute, index] {
+            return compute(index);
+        });
+        ++in_flight;
+    };
+
+    try {
+        size_t next = written;
+        size_t next_expensive = 0;
+        for (; written < requests.size(); ++written) {
+            while (next_expensive < expensive.size() && in_flight < window / 2) {
+                // Запросы до next уже запущены по порядку
+                if (const size_t index = expensive[next_expensive++]; index >= next) {
+                    submit(index);
+                }
+            }
+            // Запрос, ответ на который выводится следующим, запускается всегда
+            while (next < requests.size() && (next <= written || in_flight < window)) {
+                if (!is_follower[next] && !responses[next].valid()) {
+                    submit(next);
+                }
+                ++next;
+            }
+
+            if (is_follower[written]) {
+                write_shared(written);
+                continue;
+            }
+            Response response = responses[written].get();
+            if (!is_early[written]) {
+                --in_flight;
+            }
+            write_response(written, std::move(response));
+        }
+    } catch (...) {
+        // Задачи ссылаются на запросы, обработчик и буферы, поэтому дожидаемся их до выхода
+        for (auto& response : responses) {
+            if (response.valid()) {
+                response.wait();
+            }
+        }
+        throw;
+    }
+    writer.Finish();
+}
+
+void JsonReader::WriteStatResponses(const RequestHandler& handler, json::ArrayWriter& writer, ThreadPool* pool) const {
+    WriteStatResponsesWith(writer, pool, [this, &handler](const json::Dict& map, json::StreamBuilder& builder) {
+        ProcessStatRequest(map, handler, builder);
+    }, [&handler](const json::Dict& map) {
+        return NeedsRouter(map) && !handler.IsRouterReady();
+    });
+}
+
+void JsonReader::WriteStatResponses(const MappedRequestHandler& handler, json::ArrayWriter& writer, ThreadPool* pool) const {
+    WriteStatResponsesWith(writer, pool, [this, &handler](const json::Dict& map, json::StreamBuilder& builder) {
+        ProcessStatRequest(map, handler, builder);
+    }, NEVER_WAIT);
+}
+
+void JsonReader::WriteStatResponses(const CityRegistry& cities, json::ArrayWriter& writer, ThreadPool* pool) const {
+    WriteStatResponsesWith(writer, pool, [this, &cities](const json::Dict& map, json::StreamBuilder& builder) {
+        ProcessCityRequest(map, cities, builder);
+    }, NEVER_WAIT);
+}
+
+void JsonReader::WriteStatResponse(const json::Dict& request, const RequestHandler& handler, json::StreamBuilder& builder) const {
+    ProcessStatRequest(request, handler, builder);
+}
+
+void JsonReader::WriteStatResponse(const json::Dict& request, const MappedRequestHandler& handler, json::StreamBuilder& builder) const {
+    ProcessStatRequest(request, handler, builder);
 }
@@ -1,11 +1,19 @@
 #pragma once
 
 #include "transport_catalogue.h"
+#include "bulk_loader.h"
+#include "catalogue_update.h"
+#include "thread_pool.h"
 #include "json.h"
 #include "svg.h"
 #include "request_handler.h"
+#include "mapped_request_handler.h"
+#include "city_registry.h"
 #include "map_renderer.h"
 #include "json_builder.h"
+#include "json_view.h"
+#include "serialization.h"
+#include "memory_stats.h"
 
 #include <vector>
 
@@ -13,25 +21,108 @@ class JsonReader {
 public:
     explicit JsonReader(transport_catalogue::TransportCatalogue& db);
 
-    void ParseBaseRequests(const json::Node& root);
+    // Загружает base_requests через BulkLoader; пул ускоряет построение индексов
+    void ParseBaseRequests(const json::Node& root, ThreadPool* pool = nullptr);
+    // Читает документ из потока. base_requests попадают в каталог по мере разбора
+    // и в документе не сохраняются (там остаётся пустой массив)
+    json::Document LoadStreaming(std::istream& input, ThreadPool* pool = nullptr);
+    // Читает документ из буфера в памяти. base_requests разбираются по требованию
+    // прямо из буфера (json::LazyDocument), без копий строк и дерева Node; остальные
+    // ключи возвращаются разобранными, а под base_requests остаётся пустой массив
+    json::Document LoadLazy(std::string_view input, ThreadPool* pool = nullptr);
+    // Запоминает stat_requests; если среди них есть Stats, заодно оценивает память документа.
+    // Запросы не копируются: root должен жить, пока на них пишутся ответы.
+    // Заодно планирует ответы: запросы, одинаковые во всём, кроме id, вычисляются один раз
     void ParseStatRequests(const json::Node& root);
-    json::Node ProcessStatRequests(const RequestHandler& handler) const;
+
+    // Пишут ответы в writer по мере готовности, в порядке запросов, не собирая их в массив.
+    // С пулом запросы обрабатываются параллельно, а готовые ответы ждут своей очереди;
+    // Map и Route запускаются раньше остальных, чтобы не задерживать вывод в конце.
+    // Пока роутер обработчика строится, Route и Stats откладываются, а остальные
+    // запросы отвечаются заранее
+    void WriteStatResponses(const RequestHandler& handler, json::ArrayWriter& writer, ThreadPool* pool = nullptr) const;
+    void WriteStatResponses(const MappedRequestHandler& handler, json::ArrayWriter& writer, ThreadPool* pool = nullptr) const;
+    // Каждый запрос отвечается каталогом города из поля city; неизвестный город — not found
+    void WriteStatResponses(const CityRegistry& cities, json::ArrayWriter& writer, ThreadPool* pool = nullptr) const;
+
+    // Печатает ответ на отдельный запрос того же вида, что и элементы stat_requests.
+    // При ошибке в запросе бросает исключение, и часть ответа может остаться в выводе builder
+    void WriteStatResponse(const json::Dict& request, const RequestHandler& handler, json::StreamBuilder& builder) const;
+    void WriteStatResponse(const json::Dict& request, const MappedRequestHandler& handler, json::StreamBuilder& builder) const;
 
     map_renderer::RenderSettings ParseRenderSettings(const json::Node& root) const;
     TransportRouter::RoutingSettings ParseRoutingSettings(const json::Node& root) const;
+    serialization::SerializationSettings ParseSerializationSettings(const json::Node& root) const;
+    // Изменения базы из update_requests: Stop и Bus в формате base_requests,
+    // RemoveStop и RemoveBus по name, RemoveDistance по from и to
+    std::vector<transport_catalogue::CatalogueUpdate> ParseUpdateRequests(const json::Node& root) const;
+    std::vector<transport_catalogue::CatalogueUpdate> ParseUpdateRequests(const json::Array& requests) const;
 
 private:
     svg::Color ParseColor(const json::Node& node) const;
 
-    void ParseStop(const json::Dict& map);
-    void ParseDistances(const json::Dict& map);
-    void ParseBus(const json::Dict& map);
+    // Разбор одинаков для json::Dict и json::LazyDict.
+    // keep_names: имена копируются в пул загрузчика, и запрос можно удалить до Finish()
+    template <typename Map>
+    void ParseBaseRequest(const Map& map, transport_catalogue::BulkLoader& loader, bool keep_names) const;
+    template <typename Map>
+    const domain::Stop& ParseStop(const Map& map, transport_catalogue::BulkLoader& loader) const;
+    template <typename Map>
+    void ParseDistances(const Map& map, std::string_view from,
+                        transport_catalogue::BulkLoader& loader, bool keep_names) const;
+    template <typename Map>
+    void ParseBus(const Map& map, transport_catalogue::BulkLoader& loader, bool keep_names) const;
+    // Сначала считает объекты, чтобы зарезервировать контейнеры каталога
+    template <typename Requests>
+    void LoadBaseRequests(const Requests& base_requests, bool keep_names, ThreadPool* pool);
+
+    // План ответов на stat_requests. Ответ зависит только от полей запроса, кроме id,
+    // поэтому для группы одинаковых запросов он вычисляется по первому из них,
+    // а остальные получают его копию со своим request_id
+    struct StatPlan {
+        static constexpr size_t UNIQUE = static_cast<size_t>(-1);
+
+        // Для каждого запроса-словаря по порядку — номер группы или UNIQUE
+        std::vector<size_t> groups;
+        // Число запросов в каждой группе, не меньше двух
+        std::vector<size_t> group_sizes;
+        // Сколько ответов вычисляется на самом деле
+        size_t distinct_count = 0;
+    };
+
+    void PlanStatRequests();
+
+    // answer(map, builder) печатает ответ на один запрос. must_wait(map) — ответ сейчас
+    // пришлось бы ждать (например, роутер ещё строится); пока такие запросы есть,
+    // остальные отвечаются заранее
+    template <typename Answer, typename MustWait>
+    void WriteStatResponsesWith(json::ArrayWriter& writer, ThreadPool* pool,
+                                const Answer& answer, const MustWait& must_wait) const;
+    // Ответ группы, вычисленный один раз, с request_id запроса id
+    void WriteSharedResponse(const json::Node& response, int id, json::StreamBuilder& builder) const;
 
-    void ProcessBusRequest(const json::Dict& map, const RequestHandler& handler, json::Builder& builder) const;
-    void ProcessStopRequest(const json::Dict& map, const RequestHandler& handler, json::Builder& builder) const;
-    void ProcessMapRequest(const json::Dict& /*map*/, const RequestHandler& handler, json::Builder& builder) const;
-    void ProcessRouteRequest(const json::Dict& map, const RequestHandler& handler, json::Builder& builder) const;
+    // Ответы печатаются сразу в вывод. Ключи идут по алфавиту, как у json::Print,
+    // поэтому request_id выводит обработчик конкретного запроса в своём месте.
+    // Обработка одинакова для каталога в памяти и для образа в файле
+    void ProcessCityRequest(const json::Dict& map, const CityRegistry& cities, json::StreamBuilder& builder) const;
+    template <typename Handler>
+    void ProcessStatRequest(const json::Dict& map, const Handler& handler, json::StreamBuilder& builder) const;
+    template <typename Handler>
+    void ProcessBusRequest(const json::Dict& map, int id, const Handler& handler, json::StreamBuilder& builder) const;
+    template <typename Handler>
+    void ProcessStopRequest(const json::Dict& map, int id, const Handler& handler, json::StreamBuilder& builder) const;
+    template <typename Handler>
+    void ProcessMapRequest(const json::Dict& /*map*/, int id, const Handler& handler, json::StreamBuilder& builder) const;
+    template <typename Handler>
+    void ProcessRouteRequest(const json::Dict& map, int id, const Handler& handler, json::StreamBuilder& builder) const;
+    template <typename Handler>
+    void ProcessStatsRequest(const json::Dict& /*map*/, int id, const Handler& handler, json::StreamBuilder& builder) const;
+    // Задержки по типам запросов и методам обработчика (см. metrics.h)
+    void ProcessMetricsRequest(int id, json::StreamBuilder& builder) const;
 
     transport_catalogue::TransportCatalogue& db_;
-    std::vector<json::Node> stat_requests_;
+    // Массив в документе, переданном в ParseStatRequests
+    const json::Array* stat_requests_;
+    StatPlan stat_plan_;
+    memory_stats::Report json_stats_;
 };
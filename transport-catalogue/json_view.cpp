@@ -0,0 +1,436 @@
+#include "json_view.h"
+
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace json {
+
+namespace {
+using namespace std::literals;
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Символы, на которых заканчивается число или литерал
+bool IsDelimiter(char c) {
+    return IsSpace(c) || c == ',' || c == ':' || c == '[' || c == ']' || c == '{' || c == '}' || c == '"';
+}
+
+// Проверяет запись числа по грамматике JSON; is_int — без дробной части и экспоненты
+bool IsJsonNumber(std::string_view text, bool& is_int) {
+    size_t pos = 0;
+    auto digits = [&text, &pos] {
+        const size_t first = pos;
+        while (pos < text.size() && IsDigit(text[pos])) {
+            ++pos;
+        }
+        return pos > first;
+    };
+
+    if (pos < text.size() && text[pos] == '-') {
+        ++pos;
+    }
+    if (pos < text.size() && text[pos] == '0') {
+        ++pos;
+    } else if (!digits()) {
+        return false;
+    }
+    is_int = true;
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        if (!digits()) {
+            return false;
+        }
+        is_int = false;
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        ++pos;
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+            ++pos;
+        }
+        if (!digits()) {
+            return false;
+        }
+        is_int = false;
+    }
+    return pos == text.size();
+}
+
+// Быстрый путь для обычных чисел. Переполнение и числа у границы нормализованных
+// разбирает Load, чтобы результат и сообщения совпадали с полным разбором
+Node LoadNumber(std::string_view text) {
+    bool is_int = false;
+    if (!IsJsonNumber(text, is_int)) {
+        throw ParsingError("Failed to convert "s + std::string(text) + " to number"s);
+    }
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    if (is_int) {
+        int value;
+        if (auto [ptr, ec] = std::from_chars(begin, end, value); ec == std::errc{}) {
+            return value;
+        }
+    }
+    double value;
+    if (auto [ptr, ec] = std::from_chars(begin, end, value);
+        ec == std::errc{} && (value == 0.0 || std::fabs(value) >= 2 * DBL_MIN)) {
+        return value;
+    }
+    return Load(text).GetRoot();
+}
+
+}  // namespace
+
+LazyDocument::LazyDocument(std::string_view input)
+    : input_(input) {
+    if (input_.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw ParsingError("Input is too large for LazyDocument"s);
+    }
+    BuildIndex();
+}
+
+uint32_t LazyDocument::AddEntry(size_t begin) {
+    const auto index = static_cast<uint32_t>(entries_.size());
+    entries_.push_back({ static_cast<uint32_t>(begin), static_cast<uint32_t>(begin), index + 1 });
+    return index;
+}
+
+size_t LazyDocument::SkipSpace(size_t pos) const {
+    while (pos < input_.size() && IsSpace(input_[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+// pos — открывающая кавычка; возвращает позицию за закрывающей
+size_t LazyDocument::ScanString(size_t pos) const {
+    ++pos;
+    while (true) {
+        while (pos < input_.size() && input_[pos] != '"' && input_[pos] != '\\'
+               && input_[pos] != '\n' && input_[pos] != '\r') {
+            ++pos;
+        }
+        if (pos >= input_.size()) {
+            throw ParsingError("String parsing error"s);
+        }
+        const char c = input_[pos];
+        if (c == '"') {
+            return pos + 1;
+        }
+        if (c != '\\') {
+            throw ParsingError("Unexpected end of line"s);
+        }
+        // Сама escape-последовательность проверяется при раскодировании
+        pos += 2;
+    }
+}
+
+size_t LazyDocument::ScanScalar(size_t pos) const {
+    const size_t begin = pos;
+    while (pos < input_.size() && !IsDelimiter(input_[pos])) {
+        ++pos;
+    }
+    if (pos == begin) {
+        throw ParsingError("A digit is expected"s);
+    }
+    return pos;
+}
+
+// pos — начало ключа словаря; добавляет запись ключа и возвращает позицию после двоеточия
+size_t LazyDocument::ScanKey(size_t pos) {
+    if (pos >= input_.size()) {
+        throw ParsingError("Dictionary parsing error"s);
+    }
+    if (input_[pos] != '"') {
+        throw ParsingError(R"(',' is expected but ')"s + input_[pos] + "' has been found"s);
+    }
+    const uint32_t key = AddEntry(pos);
+    pos = ScanString(pos);
+    entries_[key].end = static_cast<uint32_t>(pos);
+
+    pos = SkipSpace(pos);
+    if (pos >= input_.size() || input_[pos] != ':') {
+        throw ParsingError(": is expected but '"s + (pos < input_.size() ? input_[pos] : '"') + "' has been found"s);
+    }
+    return pos + 1;
+}
+
+void LazyDocument::BuildIndex() {
+    // Незакрытые массивы и словари
+    std::vector<uint32_t> open;
+    size_t pos = SkipSpace(0);
+    if (pos >= input_.size()) {
+        throw ParsingError("Unexpected EOF"s);
+    }
+
+    while (true) {
+        // Здесь начинается значение
+        pos = SkipSpace(pos);
+        if (pos >= input_.size()) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        const char c = input_[pos];
+        const uint32_t index = AddEntry(pos);
+        if (c == '[' || c == '{') {
+            open.push_back(index);
+            pos = SkipSpace(pos + 1);
+            const char close = c == '[' ? ']' : '}';
+            if (pos < input_.size() && input_[pos] != close) {
+                if (c == '{') {
+                    pos = ScanKey(pos);
+                }
+                continue;
+            }
+        } else {
+            pos = c == '"' ? ScanString(pos) : ScanScalar(pos);
+            entries_[index].end = static_cast<uint32_t>(pos);
+        }
+
+        // Значение закончилось: закрываем готовые массивы и словари до следующего элемента
+        bool has_next = false;
+        while (!open.empty() && !has_next) {
+            Entry& container = entries_[open.back()];
+            const bool is_dict = input_[container.begin] == '{';
+            pos = SkipSpace(pos);
+            if (pos >= input_.size()) {
+                throw ParsingError(is_dict ? "Dictionary parsing error"s : "Array parsing error"s);
+            }
+            const char next = input_[pos];
+            if (next == ',') {
+                pos = is_dict ? ScanKey(SkipSpace(pos + 1)) : pos + 1;
+                has_next = true;
+            } else if (next == (is_dict ? '}' : ']')) {
+                ++pos;
+                container.end = static_cast<uint32_t>(pos);
+                container.next = static_cast<uint32_t>(entries_.size());
+                open.pop_back();
+            } else {
+                throw ParsingError(R"(',' is expected but ')"s + next + "' has been found"s);
+            }
+        }
+        if (!has_next) {
+            return;
+        }
+    }
+}
+
+std::string_view LazyDocument::DecodeString(uint32_t index) const {
+    const std::string_view text = GetText(index);
+    const std::string_view content = text.substr(1, text.size() - 2);
+    if (content.find('\\') == std::string_view::npos) {
+        return content;
+    }
+
+    std::lock_guard lock(decoded_mutex_);
+    auto it = decoded_.find(index);
+    if (it == decoded_.end()) {
+        it = decoded_.emplace(index, Load(text).GetRoot().AsString()).first;
+    }
+    return it->second;
+}
+
+char LazyValue::GetFirstChar() const {
+    return doc_->input_[doc_->entries_[index_].begin];
+}
+
+bool LazyValue::IsNull() const {
+    return GetRaw() == "null"sv;
+}
+
+bool LazyValue::IsBool() const {
+    const std::string_view raw = GetRaw();
+    return raw == "true"sv || raw == "false"sv;
+}
+
+bool LazyValue::IsInt() const {
+    bool is_int = false;
+    int value;
+    const std::string_view raw = GetRaw();
+    return IsJsonNumber(raw, is_int) && is_int
+        && std::from_chars(raw.data(), raw.data() + raw.size(), value).ec == std::errc{};
+}
+
+bool LazyValue::IsDouble() const {
+    bool is_int = false;
+    return IsJsonNumber(GetRaw(), is_int);
+}
+
+bool LazyValue::IsString() const {
+    return GetFirstChar() == '"';
+}
+
+bool LazyValue::IsArray() const {
+    return GetFirstChar() == '[';
+}
+
+bool LazyValue::IsDict() const {
+    return GetFirstChar() == '{';
+}
+
+bool LazyValue::AsBool() const {
+    const std::string_view raw = GetRaw();
+    if (raw == "true"sv) {
+        return true;
+    }
+    if (raw == "false"sv) {
+        return false;
+    }
+    const char c = GetFirstChar();
+    if (c == 't' || c == 'f') {
+        throw ParsingError("Failed to parse '"s + std::string(raw) + "' as bool"s);
+    }
+    throw std::logic_error("Not a bool"s);
+}
+
+int LazyValue::AsInt() const {
+    const char c = GetFirstChar();
+    if (c != '-' && !IsDigit(c)) {
+        throw std::logic_error("Not an int"s);
+    }
+    return LoadNumber(GetRaw()).AsInt();
+}
+
+double LazyValue::AsDouble() const {
+    const char c = GetFirstChar();
+    if (c != '-' && !IsDigit(c)) {
+        throw std::logic_error("Not a double"s);
+    }
+    return LoadNumber(GetRaw()).AsDouble();
+}
+
+std::string_view LazyValue::AsString() const {
+    if (!IsString()) {
+        throw std::logic_error("Not a string"s);
+    }
+    return doc_->DecodeString(index_);
+}
+
+LazyArray LazyValue::AsArray() const {
+    if (!IsArray()) {
+        throw std::logic_error("Not an array"s);
+    }
+    return LazyArray(*doc_, index_);
+}
+
+LazyDict LazyValue::AsDict() const {
+    if (!IsDict()) {
+        throw std::logic_error("Not a dict"s);
+    }
+    return LazyDict(*doc_, index_);
+}
+
+std::string_view LazyValue::GetRaw() const {
+    return doc_->GetText(index_);
+}
+
+Node LazyValue::ToNode() const {
+    // Значения разбираются теми же методами, что и при обращении по одному,
+    // поэтому грамматика не мягче, чем у самого LazyDocument
+    switch (GetFirstChar()) {
+        case '[': {
+            const LazyArray elements = AsArray();
+            Array result;
+            result.reserve(elements.size());
+            for (const LazyValue element : elements) {
+                result.push_back(element.ToNode());
+            }
+            return Node(std::move(result));
+        }
+        case '{': {
+            Dict::Items items;
+            for (const auto [key, value] : AsDict()) {
+                items.emplace_back(std::string(key), value.ToNode());
+            }
+            return Node(Dict(std::move(items)));
+        }
+        case '"':
+            return Node(std::string(AsString()));
+        case 't':
+            [[fallthrough]];
+        case 'f':
+            return Node(AsBool());
+        case 'n':
+            if (!IsNull()) {
+                throw ParsingError("Failed to parse '"s + std::string(GetRaw()) + "' as null"s);
+            }
+            return Node(nullptr);
+        default:
+            return LoadNumber(GetRaw());
+    }
+}
+
+LazyArray::const_iterator& LazyArray::const_iterator::operator++() {
+    index_ = doc_->entries_[index_].next;
+    return *this;
+}
+
+LazyArray::const_iterator LazyArray::begin() const {
+    return const_iterator(*doc_, index_ + 1);
+}
+
+LazyArray::const_iterator LazyArray::end() const {
+    return const_iterator(*doc_, doc_->entries_[index_].next);
+}
+
+size_t LazyArray::size() const {
+    return static_cast<size_t>(std::distance(begin(), end()));
+}
+
+LazyValue LazyArray::operator[](size_t index) const {
+    size_t current = 0;
+    for (auto it = begin(); it != end(); ++it, ++current) {
+        if (current == index) {
+            return *it;
+        }
+    }
+    throw std::out_of_range("Array index is out of range"s);
+}
+
+LazyDict::value_type LazyDict::const_iterator::operator*() const {
+    return { LazyValue(*doc_, index_).AsString(), LazyValue(*doc_, index_ + 1) };
+}
+
+LazyDict::const_iterator& LazyDict::const_iterator::operator++() {
+    index_ = doc_->entries_[index_ + 1].next;
+    return *this;
+}
+
+LazyDict::const_iterator LazyDict::begin() const {
+    return const_iterator(*doc_, index_ + 1);
+}
+
+LazyDict::const_iterator LazyDict::end() const {
+    return const_iterator(*doc_, doc_->entries_[index_].next);
+}
+
+size_t LazyDict::size() const {
+    return static_cast<size_t>(std::distance(begin(), end()));
+}
+
+LazyDict::const_iterator LazyDict::find(std::string_view key) const {
+    const auto last = end();
+    for (auto it = begin(); it != last; ++it) {
+        if (LazyValue(*doc_, it.index_).AsString() == key) {
+            return it;
+        }
+    }
+    return last;
+}
+
+LazyValue LazyDict::at(std::string_view key) const {
+    const auto it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("No key '"s + std::string(key) + "'"s);
+    }
+    return (*it).second;
+}
+
+}  // namespace json
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace json {
+
+    class LazyDocument;
+    class LazyArray;
+    class LazyDict;
+
+    // Значение в LazyDocument. Ничего не разбирает заранее: строки отдаются как string_view
+    // во входной буфер, числа и литералы преобразуются при каждом обращении.
+    // Интерфейс повторяет Node, поэтому шаблонный код работает с обоими.
+    // Действительно, пока жив документ и его входной буфер
+    class LazyValue {
+    public:
+        bool IsNull() const;
+        bool IsBool() const;
+        bool IsInt() const;
+        bool IsDouble() const;
+        bool IsString() const;
+        bool IsArray() const;
+        bool IsDict() const;
+
+        // При несовпадении типа, как и Node, выбрасывают std::logic_error;
+        // при ошибке в записи числа или литерала — ParsingError
+        bool AsBool() const;
+        int AsInt() const;
+        double AsDouble() const;
+        // Строка без escape-последовательностей указывает прямо во вход;
+        // остальные раскодируются один раз и хранятся в документе
+        std::string_view AsString() const;
+        LazyArray AsArray() const;
+        LazyDict AsDict() const;
+
+        // Текст значения во входе как есть
+        std::string_view GetRaw() const;
+        // Разбирает значение целиком в обычный Node в куче.
+        // Повторяющиеся ключи словаря дают std::logic_error, как у конструктора Dict
+        Node ToNode() const;
+
+    private:
+        friend class LazyDocument;
+        friend class LazyArray;
+        friend class LazyDict;
+
+        LazyValue(const LazyDocument& doc, uint32_t index)
+            : doc_(&doc)
+            , index_(index) {
+        }
+
+        char GetFirstChar() const;
+
+        const LazyDocument* doc_;
+        uint32_t index_;
+    };
+
+    // Элементы массива. Размер и доступ по номеру — за линейное время
+    class LazyArray {
+    public:
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = LazyValue;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = LazyValue;
+
+            LazyValue operator*() const {
+                return LazyValue(*doc_, index_);
+            }
+            const_iterator& operator++();
+            bool operator==(const const_iterator& rhs) const {
+                return index_ == rhs.index_;
+            }
+            bool operator!=(const const_iterator& rhs) const {
+                return !(*this == rhs);
+            }
+
+        private:
+            friend class LazyArray;
+
+            const_iterator(const LazyDocument& doc, uint32_t index)
+                : doc_(&doc)
+                , index_(index) {
+            }
+
+            const LazyDocument* doc_;
+            uint32_t index_;
+        };
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const {
+            return begin() == end();
+        }
+        // При выходе за границы выбрасывает std::out_of_range
+        LazyValue operator[](size_t index) const;
+
+    private:
+        friend class LazyValue;
+
+        LazyArray(const LazyDocument& doc, uint32_t index)
+            : doc_(&doc)
+            , index_(index) {
+        }
+
+        const LazyDocument* doc_;
+        uint32_t index_;
+    };
+
+    // Пары словаря в порядке входа. Поиск ключа — линейный просмотр без разбора значений.
+    // Повторяющиеся ключи, в отличие от Load, не проверяются: находится первый
+    class LazyDict {
+    public:
+        using value_type = std::pair<std::string_view, LazyValue>;
+
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = LazyDict::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            value_type operator*() const;
+            const_iterator& operator++();
+            bool operator==(const const_iterator& rhs) const {
+                return index_ == rhs.index_;
+            }
+            bool operator!=(const const_iterator& rhs) const {
+                return !(*this == rhs);
+            }
+
+        private:
+            friend class LazyDict;
+
+            // index — запись ключа; значение идёт следующей записью
+            const_iterator(const LazyDocument& doc, uint32_t index)
+                : doc_(&doc)
+                , index_(index) {
+            }
+
+            const LazyDocument* doc_;
+            uint32_t index_;
+        };
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const {
+            return begin() == end();
+        }
+
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const {
+            return find(key) != end() ? 1 : 0;
+        }
+        // Как у Dict: при отсутствии ключа выбрасывает std::out_of_range
+        LazyValue at(std::string_view key) const;
+
+    private:
+        friend class LazyValue;
+
+        LazyDict(const LazyDocument& doc, uint32_t index)
+            : doc_(&doc)
+            , index_(index) {
+        }
+
+        const LazyDocument* doc_;
+        uint32_t index_;
+    };
+
+    // Документ для чтения по требованию, как ondemand в simdjson. Конструктор делает один
+    // проход по входу: проверяет скобки, запятые и двоеточия и строит индекс значений,
+    // в котором у каждого массива и словаря записан конец, так что ненужное значение
+    // пропускается за O(1). Числа, литералы и escape-последовательности проверяются
+    // только при обращении к ним. Данные после корневого значения игнорируются, как у Load,
+    // но пропущенные и лишние запятые, в отличие от Load, считаются ошибкой.
+    // Вход должен жить дольше документа; документ не копируется и не перемещается,
+    // потому что значения ссылаются на него. Чтение из нескольких потоков допустимо
+    class LazyDocument {
+    public:
+        explicit LazyDocument(std::string_view input);
+
+        LazyDocument(const LazyDocument&) = delete;
+        LazyDocument& operator=(const LazyDocument&) = delete;
+
+        LazyValue GetRoot() const {
+            return LazyValue(*this, 0);
+        }
+
+        // Память индекса, для оценки накладных расходов
+        size_t GetIndexBytes() const {
+            return entries_.capacity() * sizeof(Entry);
+        }
+
+    private:
+        friend class LazyValue;
+        friend class LazyArray;
+        friend class LazyDict;
+
+        // Значение во входе. У ключей словаря свои записи перед записью значения
+        struct Entry {
+            // Первый символ и позиция за последним символом значения
+            uint32_t begin;
+            uint32_t end;
+            // Запись, следующая за значением и всеми вложенными в него
+            uint32_t next;
+        };
+
+        void BuildIndex();
+        uint32_t AddEntry(size_t begin);
+        size_t SkipSpace(size_t pos) const;
+        size_t ScanString(size_t pos) const;
+        size_t ScanScalar(size_t pos) const;
+        size_t ScanKey(size_t pos);
+
+        std::string_view GetText(uint32_t index) const {
+            const Entry& entry = entries_[index];
+            return input_.substr(entry.begin, entry.end - entry.begin);
+        }
+        std::string_view DecodeString(uint32_t index) const;
+
+        std::string_view input_;
+        std::vector<Entry> entries_;
+        mutable std::mutex decoded_mutex_;
+        // Раскодированные строки с escape-последовательностями, по номеру записи
+        mutable std::unordered_map<uint32_t, std::string> decoded_;
+    };
+
+}  // namespace json
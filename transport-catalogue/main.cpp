@@ -1,32 +1,470 @@
+#include "async_writer.h"
 #include "json_reader.h"
 #include "request_handler.h"
 #include "map_renderer.h"
+#include "serialization.h"
+#include "catalogue_image.h"
+#include "catalogue_service.h"
+#include "city_registry.h"
+#include "delta_log.h"
+#include "mapped_file.h"
+#include "mapped_request_handler.h"
+#include "request_server.h"
+#include "thread_pool.h"
 #include "json.h"
+#include "msgpack.h"
+#include "memory_stats.h"
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
 
-int main() {
-    json::Document doc = json::Load(std::cin);
-    const json::Node& root = doc.GetRoot();
+using namespace std::literals;
 
-    transport_catalogue::TransportCatalogue db;
-    JsonReader reader(db);
+namespace {
 
-    // Настройки
-    reader.ParseBaseRequests(root);
-    auto render_settings = reader.ParseRenderSettings(root);
-    auto routing_settings = reader.ParseRoutingSettings(root);
-    reader.ParseStatRequests(root);
+    void PrintUsage(std::ostream& stream = std::cerr) {
+        stream << "Usage: transport_catalogue [make_base|process_requests|update_base|compact_base] [--memory-stats] [--compact] [--msgpack] [--threads N]\n"sv
+               << "       transport_catalogue serve --config FILE [--socket PATH] [--memory-stats] [--threads N]\n"sv;
+    }
 
-    // Парсим запросы
-    reader.ParseBaseRequests(root);
-    reader.ParseStatRequests(root);
+    struct Options {
+        std::string_view mode;
+        // Печатать в stderr оценку памяти после каждого этапа
+        bool memory_stats = false;
+        // Печатать ответы без пробелов и переводов строк
+        bool compact = false;
+        // Вход и вывод в MessagePack вместо JSON
+        bool msgpack = false;
+        // Потоки пула режима: 0 — по числу аппаратных потоков. При 1 пулом только загружается база
+        // (в нём тогда столько потоков, сколько аппаратных), а stat_requests отвечаются по очереди
+        size_t threads = 1;
+        // Для serve: документ с базой или с serialization_settings
+        std::string_view config;
+        // Для serve: Unix-сокет, на котором принимаются запросы вместо stdin
+        std::string_view socket;
+    };
 
-    // Создаем рендерер и обработчик запросов
-    map_renderer::MapRenderer renderer(render_settings);
-    TransportRouter router(db, routing_settings);
-    RequestHandler handler(db, renderer, &router);
+    std::optional<Options> ParseOptions(int argc, char* argv[]) {
+        Options options;
+        bool has_mode = false;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            if (arg == "--memory-stats"sv) {
+                options.memory_stats = true;
+            }
+            else if (arg == "--compact"sv) {
+                options.compact = true;
+            }
+            else if (arg == "--msgpack"sv) {
+                options.msgpack = true;
+            }
+            else if (arg == "--threads"sv && i + 1 < argc) {
+                const std::string_view value = argv[++i];
+                const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options.threads);
+                if (ec != std::errc{} || ptr != value.data() + value.size()) {
+                    return std::nullopt;
+                }
+            }
+            else if ((arg == "--config"sv || arg == "--socket"sv) && i + 1 < argc) {
+                (arg == "--config"sv ? options.config : options.socket) = argv[++i];
+            }
+            else if (!has_mode && arg.substr(0, 2) != "--"sv) {
+                options.mode = arg;
+                has_mode = true;
+            }
+            else {
+                return std::nullopt;
+            }
+        }
+        return options;
+    }
 
-    // Обрабатываем запросы (включая рендеринг карты)
-    auto answers = reader.ProcessStatRequests(handler);
-    json::Print(json::Document{ answers }, std::cout);
+    // Один пул на весь режим: его делят загрузка базы, города, ответы на stat_requests и сервер
+    size_t GetPoolSize(const Options& options) {
+        return options.threads == 1 ? 0 : options.threads;
+    }
+
+    ThreadPool* GetAnswerPool(const Options& options, ThreadPool& pool) {
+        return options.threads != 1 ? &pool : nullptr;
+    }
+
+    void DumpMemory(const Options& options, std::string_view phase, const memory_stats::Report& report) {
+        if (options.memory_stats) {
+            memory_stats::PrintReport(std::cerr, phase, report);
+        }
+    }
+
+    json::Document LoadInput(const Options& options) {
+        return options.msgpack ? msgpack::Load(std::cin) : json::Load(std::cin);
+    }
+
+    // Вход с base_requests: они попадают в каталог reader, а в документе остаётся пустой массив.
+    // JSON разбирается потоком, MessagePack — целиком: он компактнее, а числа в нём уже двоичные
+    json::Document LoadBaseInput(const Options& options, JsonReader& reader, ThreadPool& pool) {
+        if (!options.msgpack) {
+            return reader.LoadStreaming(std::cin, &pool);
+        }
+        json::Document doc = msgpack::Load(std::cin);
+        if (doc.GetRoot().AsDict().count("base_requests") != 0) {
+            reader.ParseBaseRequests(doc.GetRoot(), &pool);
+            doc.Release("base_requests"sv);
+        }
+        return doc;
+    }
+
+    // Ответы выводятся по мере готовности и целиком в памяти не собираются.
+    // В stdout их пишет отдельный поток, пока следующие ответы ещё печатаются
+    template <typename Handler>
+    void WriteAnswers(const Options& options, const JsonReader& reader, const Handler& handler, ThreadPool& pool) {
+        json::PrintSettings settings;
+        settings.compact = options.compact;
+        if (options.msgpack) {
+            settings.encoding = json::Encoding::MESSAGE_PACK;
+        }
+        AsyncWriter output(std::cout);
+        json::ArrayWriter writer(output.GetStream(), settings);
+        try {
+            reader.WriteStatResponses(handler, writer, GetAnswerPool(options, pool));
+        } catch (...) {
+            // Необработанное исключение завершает программу без раскрутки стека:
+            // ответы до ошибки выводятся здесь
+            output.Finish();
+            throw;
+        }
+        output.Finish();
+    }
+
+    // Этапы идут внахлёст: роутер строится в своём потоке, пока разбираются stat_requests
+    // и отвечаются Bus, Stop и Map, а вывод пишется ещё одним потоком. Так время работы
+    // ближе к самому долгому этапу, а не к сумме всех
+    void AnswerStatRequests(const Options& options, JsonReader& reader, const json::Node& root,
+                            const transport_catalogue::TransportCatalogue& db,
+                            const map_renderer::RenderSettings& render_settings,
+                            const TransportRouter::RoutingSettings& routing_settings, ThreadPool& pool) {
+        RequestHandler::PendingRouter router = std::async(std::launch::async, [&db, &routing_settings] {
+            return std::make_unique<const TransportRouter>(db, routing_settings);
+        });
+        map_renderer::MapRenderer renderer(render_settings);
+        RequestHandler handler(db, renderer, router);
+
+        reader.ParseStatRequests(root);
+        // Оценка памяти роутера дожидается его построения
+        if (options.memory_stats) {
+            DumpMemory(options, "router"sv, handler.GetMemoryStats());
+        }
+
+        WriteAnswers(options, reader, handler, pool);
+    }
+
+    // Несколько городов: в "cities" у каждого города свой документ того же вида,
+    // что и для одного города, а stat_requests общие и содержат поле city
+    const json::Dict* FindCities(const json::Node& root) {
+        if (auto it = root.AsDict().find("cities"); it != root.AsDict().end()) {
+            return &it->second.AsDict();
+        }
+        return nullptr;
+    }
+
+    void AnswerCityRequests(const Options& options, json::Document& doc, const CityRegistry::CityLoader& load,
+                            ThreadPool& pool) {
+        const CityRegistry registry(*FindCities(doc.GetRoot()), pool, load);
+        // Базы городов уже загружены, их запросы больше не нужны
+        doc.Release("cities"sv);
+        DumpMemory(options, "router"sv, registry.GetMemoryStats());
+
+        transport_catalogue::TransportCatalogue unused_db;
+        JsonReader reader(unused_db);
+        reader.ParseStatRequests(doc.GetRoot());
+        WriteAnswers(options, reader, registry, pool);
+    }
+
+    std::unique_ptr<const CatalogueSnapshot> BuildCity(const json::Node& city,
+                                                       const std::shared_ptr<transport_catalogue::NamePool>& names) {
+        transport_catalogue::TransportCatalogue db(names);
+        JsonReader reader(db);
+        reader.ParseBaseRequests(city);
+        return std::make_unique<const CatalogueSnapshot>(std::move(db),
+                                                         reader.ParseRenderSettings(city),
+                                                         reader.ParseRoutingSettings(city));
+    }
+
+    std::unique_ptr<const CatalogueSnapshot> LoadCity(const json::Node& city,
+                                                      const std::shared_ptr<transport_catalogue::NamePool>& names) {
+        transport_catalogue::TransportCatalogue unused_db;
+        const auto settings = JsonReader(unused_db).ParseSerializationSettings(city);
+        auto base = serialization::LoadBase(settings.file, nullptr, names);
+        if (!settings.delta_log.empty()) {
+            serialization::ReplayDeltaLog(base.db, settings.delta_log);
+        }
+        return std::make_unique<const CatalogueSnapshot>(std::move(base.db), base.render_settings, base.routing_settings);
+    }
+
+    // Полный цикл: база и запросы к ней в одном входном документе
+    void RunAll(const Options& options) {
+        transport_catalogue::TransportCatalogue db;
+        JsonReader reader(db);
+        ThreadPool pool(GetPoolSize(options));
+
+        // base_requests попадают в каталог прямо во время разбора JSON, в документе их нет
+        json::Document doc = LoadBaseInput(options, reader, pool);
+        const json::Node& root = doc.GetRoot();
+        DumpMemory(options, "parse"sv, { memory_stats::CollectJson("json.document", root) });
+        DumpMemory(options, "base"sv, db.GetMemoryStats());
+
+        // У каждого города свои base_requests, они разбираются из документа
+        if (FindCities(root)) {
+            AnswerCityRequests(options, doc, BuildCity, pool);
+            return;
+        }
+
+        // Настройки
+        auto render_settings = reader.ParseRenderSettings(root);
+        auto routing_settings = reader.ParseRoutingSettings(root);
+
+        AnswerStatRequests(options, reader, root, db, render_settings, routing_settings, pool);
+    }
+
+    // Строит каталог по base_requests и сохраняет его вместе с настройками в файл
+    void MakeBase(const Options& options) {
+        transport_catalogue::TransportCatalogue db;
+        JsonReader reader(db);
+        ThreadPool pool(GetPoolSize(options));
+
+        json::Document doc = LoadBaseInput(options, reader, pool);
+        const json::Node& root = doc.GetRoot();
+        DumpMemory(options, "parse"sv, { memory_stats::CollectJson("json.document", root) });
+        DumpMemory(options, "base"sv, db.GetMemoryStats());
+        const auto render_settings = reader.ParseRenderSettings(root);
+        const auto routing_settings = reader.ParseRoutingSettings(root);
+        const auto serialization_settings = reader.ParseSerializationSettings(root);
+
+        serialization::SaveBase(db, render_settings, routing_settings, serialization_settings.file);
+        if (!serialization_settings.image.empty()) {
+            catalogue_image::SaveImage(db, render_settings, routing_settings, serialization_settings.image);
+        }
+        // Новая база заменяет и все накопленные изменения
+        if (!serialization_settings.delta_log.empty()) {
+            std::remove(serialization_settings.delta_log.c_str());
+        }
+    }
+
+    // Сворачивает журнал изменений в базу и обновляет образ каталога
+    void CompactBaseFiles(const serialization::SerializationSettings& settings, ThreadPool& pool) {
+        auto base = serialization::CompactBase(settings.file, settings.delta_log, &pool);
+        if (!settings.image.empty()) {
+            catalogue_image::SaveImage(base.db, base.render_settings, base.routing_settings, settings.image);
+        }
+    }
+
+    serialization::SerializationSettings ParseDeltaLogSettings(const JsonReader& reader, const json::Node& root) {
+        auto settings = reader.ParseSerializationSettings(root);
+        if (settings.delta_log.empty()) {
+            throw std::runtime_error("serialization_settings.delta_log is required"s);
+        }
+        return settings;
+    }
+
+    // Дописывает update_requests в журнал изменений. Когда журнал становится
+    // больше самой базы, его применение дороже загрузки, и журнал сворачивается
+    void UpdateBase(const Options& options) {
+        json::Document doc = LoadInput(options);
+        const json::Node& root = doc.GetRoot();
+
+        transport_catalogue::TransportCatalogue db;
+        JsonReader reader(db);
+        const auto settings = ParseDeltaLogSettings(reader, root);
+
+        serialization::DeltaLog(settings.delta_log).Append(reader.ParseUpdateRequests(root));
+
+        if (std::filesystem::file_size(settings.delta_log) >= std::filesystem::file_size(settings.file)) {
+            ThreadPool pool(GetPoolSize(options));
+            CompactBaseFiles(settings, pool);
+        }
+    }
+
+    void CompactBase(const Options& options) {
+        json::Document doc = LoadInput(options);
+        const json::Node& root = doc.GetRoot();
+
+        transport_catalogue::TransportCatalogue db;
+        JsonReader reader(db);
+        ThreadPool pool(GetPoolSize(options));
+        CompactBaseFiles(ParseDeltaLogSettings(reader, root), pool);
+    }
+
+    // Отвечает на stat_requests прямо по образу каталога, ничего не загружая в память
+    void ProcessRequestsFromImage(const Options& options, JsonReader& reader, const json::Node& root,
+                                  const std::string& image, ThreadPool& pool) {
+        const MappedFile file(image);
+        const catalogue_image::CatalogueView view(file.GetData());
+        const MappedRequestHandler handler(view);
+        DumpMemory(options, "base"sv, handler.GetMemoryStats());
+
+        reader.ParseStatRequests(root);
+        WriteAnswers(options, reader, handler, pool);
+    }
+
+    // Загружает сохранённую базу и отвечает только на stat_requests
+    void ProcessRequests(const Options& options) {
+        json::Document doc = LoadInput(options);
+        const json::Node& root = doc.GetRoot();
+        DumpMemory(options, "parse"sv, { memory_stats::CollectJson("json.document", root) });
+        ThreadPool pool(GetPoolSize(options));
+
+        // Базы городов создаются отдельными запусками make_base
+        if (FindCities(root)) {
+            AnswerCityRequests(options, doc, LoadCity, pool);
+            return;
+        }
+
+        transport_catalogue::TransportCatalogue db;
+        JsonReader reader(db);
+
+        const auto serialization_settings = reader.ParseSerializationSettings(root);
+        std::vector<transport_catalogue::CatalogueUpdate> updates;
+        if (!serialization_settings.delta_log.empty()) {
+            updates = serialization::ReadDeltaLog(serialization_settings.delta_log);
+        }
+        // Образ не содержит изменений из журнала, поэтому используется только без них
+        if (!serialization_settings.image.empty() && updates.empty()) {
+            ProcessRequestsFromImage(options, reader, root, serialization_settings.image, pool);
+            return;
+        }
+
+        auto base = serialization::LoadBase(serialization_settings.file, &pool);
+        db = std::move(base.db);
+        transport_catalogue::ApplyUpdates(db, updates);
+        DumpMemory(options, "base"sv, db.GetMemoryStats());
+
+        AnswerStatRequests(options, reader, root, db, base.render_settings, base.routing_settings, pool);
+    }
+
+    // Отвечает на запросы в формате JSON Lines из stdin или из сокета, пока вход не закончится
+    void RunServer(const Options& options, const RequestServer& server, ThreadPool& pool) {
+        if (options.socket.empty()) {
+            server.Serve(std::cin, std::cout);
+            return;
+        }
+        server.ServeUnixSocket(std::string(options.socket), pool);
+    }
+
+    template <typename Handler>
+    void ServeRequests(const Options& options, const JsonReader& reader, const Handler& handler, ThreadPool& pool) {
+        const RequestServer server([&reader, &handler](const json::Dict& request, json::StreamBuilder& builder) {
+            if (request.count("update_requests")) {
+                throw std::invalid_argument("update_requests are not supported for a catalogue image"s);
+            }
+            reader.WriteStatResponse(request, handler, builder);
+        });
+        RunServer(options, server, pool);
+    }
+
+    // Как ServeRequests, но строка с update_requests (тот же массив, что во входе update_base) меняет каталог.
+    // Ответ на неё — { "request_id": id } после публикации нового снимка или error_message, если пачку
+    // применить не удалось. Остальные запросы отвечаются по снимку, опубликованному к началу их обработки
+    void ServeCatalogue(const Options& options, const JsonReader& reader, CatalogueService& service,
+                        ThreadPool& pool) {
+        CatalogueUpdater updater(service);
+        const RequestServer server([&reader, &service, &updater](const json::Dict& request, json::StreamBuilder& builder) {
+            if (auto it = request.find("update_requests"); it != request.end()) {
+                updater.Submit(reader.ParseUpdateRequests(it->second.AsArray())).get();
+                builder.StartDict();
+                if (auto id = request.find("id"); id != request.end()) {
+                    builder.Key("request_id").Value(id->second.AsInt());
+                }
+                builder.EndDict();
+                return;
+            }
+            const auto snapshot = service.GetSnapshot();
+            reader.WriteStatResponse(request, snapshot->GetHandler(), builder);
+        });
+        RunServer(options, server, pool);
+    }
+
+    // Загружает базу один раз и отвечает на запросы без перезапуска процесса.
+    // Конфигурация — документ того же вида, что вход process_requests или полный вход с base_requests
+    void Serve(const Options& options) {
+        if (options.config.empty()) {
+            throw std::invalid_argument("serve requires --config FILE"s);
+        }
+        // Запросы и ответы разделяются переводами строк, а в MessagePack это обычный байт
+        if (options.msgpack) {
+            throw std::invalid_argument("serve speaks JSON Lines only; --msgpack is not supported"s);
+        }
+        transport_catalogue::TransportCatalogue db;
+        JsonReader reader(db);
+        ThreadPool pool(GetPoolSize(options));
+        // base_requests читаются прямо из отображённого файла; после загрузки он не нужен
+        const json::Document doc = reader.LoadLazy(MappedFile(std::string(options.config)).GetData(), &pool);
+        const json::Node& root = doc.GetRoot();
+
+        if (root.AsDict().count("serialization_settings") == 0) {
+            DumpMemory(options, "base"sv, db.GetMemoryStats());
+            CatalogueService service(std::move(db), reader.ParseRenderSettings(root),
+                                     reader.ParseRoutingSettings(root));
+            DumpMemory(options, "router"sv, service.GetSnapshot()->GetHandler().GetMemoryStats());
+            ServeCatalogue(options, reader, service, pool);
+            return;
+        }
+
+        const auto serialization_settings = reader.ParseSerializationSettings(root);
+        std::vector<transport_catalogue::CatalogueUpdate> updates;
+        if (!serialization_settings.delta_log.empty()) {
+            updates = serialization::ReadDeltaLog(serialization_settings.delta_log);
+        }
+        if (!serialization_settings.image.empty() && updates.empty()) {
+            const MappedFile file(serialization_settings.image);
+            const catalogue_image::CatalogueView view(file.GetData());
+            const MappedRequestHandler handler(view);
+            DumpMemory(options, "base"sv, handler.GetMemoryStats());
+            ServeRequests(options, reader, handler, pool);
+            return;
+        }
+
+        auto base = serialization::LoadBase(serialization_settings.file, &pool);
+        transport_catalogue::ApplyUpdates(base.db, updates);
+        DumpMemory(options, "base"sv, base.db.GetMemoryStats());
+        CatalogueService service(std::move(base.db), base.render_settings, base.routing_settings);
+        DumpMemory(options, "router"sv, service.GetSnapshot()->GetHandler().GetMemoryStats());
+        ServeCatalogue(options, reader, service, pool);
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const auto options = ParseOptions(argc, argv);
+    if (!options) {
+        PrintUsage();
+        return 1;
+    }
+
+    const std::string_view mode = options->mode;
+    if (mode.empty()) {
+        RunAll(*options);
+    }
+    else if (mode == "make_base"sv) {
+        MakeBase(*options);
+    }
+    else if (mode == "process_requests"sv) {
+        ProcessRequests(*options);
+    }
+    else if (mode == "update_base"sv) {
+        UpdateBase(*options);
+    }
+    else if (mode == "compact_base"sv) {
+        CompactBase(*options);
+    }
+    else if (mode == "serve"sv) {
+        Serve(*options);
+    }
+    else {
+        PrintUsage();
+        return 1;
+    }
 }
@@ -0,0 +1,68 @@
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TC_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+using namespace std::literals;
+
+#ifdef TC_HAS_MMAP
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open "s + path);
+    }
+
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat "s + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+
+    // Пустой файл отобразить нельзя, он представляется пустым буфером
+    if (size_ > 0) {
+        void* address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Failed to map "s + path);
+        }
+        data_ = static_cast<const char*>(address);
+        mapped_ = true;
+    }
+    // Отображение остаётся действительным и после закрытия дескриптора
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mapped_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input) {
+        throw std::runtime_error("Failed to open "s + path);
+    }
+    buffer_.resize(static_cast<size_t>(input.tellg()));
+    input.seekg(0);
+    if (!input.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()))) {
+        throw std::runtime_error("Failed to read "s + path);
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
@@ -0,0 +1,55 @@
+#include "mapped_request_handler.h"
+
+MappedRequestHandler::MappedRequestHandler(const catalogue_image::CatalogueView& view)
+    : view_(view) {}
+
+std::optional<transport_catalogue::BusInfo> MappedRequestHandler::GetBusStat(const std::string& bus_name) const {
+    return view_.GetBusInfo(bus_name);
+}
+
+std::optional<catalogue_image::BusNameRange> MappedRequestHandler::GetBusesByStop(const std::string& stop_name) const {
+    const auto stop = view_.FindStop(stop_name);
+    if (!stop) {
+        return std::nullopt;
+    }
+    return view_.GetBusesForStop(*stop);
+}
+
+std::optional<catalogue_image::StopId> MappedRequestHandler::FindStop(const std::string& stop_name) const {
+    return view_.FindStop(stop_name);
+}
+
+svg::Document MappedRequestHandler::RenderMap() const {
+    return GetSnapshot().GetHandler().RenderMap();
+}
+
+std::shared_ptr<const std::string> MappedRequestHandler::GetEncodedMap(json::Encoding encoding) const {
+    return GetSnapshot().GetHandler().GetEncodedMap(encoding);
+}
+
+std::optional<TransportRouter::RouteResult> MappedRequestHandler::BuildRoute(std::string_view from, std::string_view to) const {
+    return GetSnapshot().GetHandler().BuildRoute(from, to);
+}
+
+memory_stats::Report MappedRequestHandler::GetMemoryStats() const {
+    // Страницы образа принадлежат page cache и делятся между процессами
+    memory_stats::Report report{
+        { "image.mapped", view_.GetStopCount() + view_.GetBusCount(), view_.GetSize() },
+    };
+    if (materialized_) {
+        auto snapshot_report = snapshot_->GetHandler().GetMemoryStats();
+        report.insert(report.end(), snapshot_report.begin(), snapshot_report.end());
+    }
+    return report;
+}
+
+const CatalogueSnapshot& MappedRequestHandler::GetSnapshot() const {
+    std::call_once(snapshot_flag_, [this] {
+        const auto settings = view_.GetSettings();
+        snapshot_ = std::make_unique<const CatalogueSnapshot>(view_.Materialize(),
+                                                              settings.render_settings,
+                                                              settings.routing_settings);
+        materialized_ = true;
+    });
+    return *snapshot_;
+}
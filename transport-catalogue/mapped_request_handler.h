@@ -0,0 +1,41 @@
+#pragma once
+
+#include "catalogue_image.h"
+#include "catalogue_service.h"
+#include "memory_stats.h"
+#include "transport_router.h"
+#include "svg.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Обработчик запросов поверх образа каталога, отображённого в память.
+// Bus и Stop отвечаются прямо из образа; для карты и маршрутов при первом
+// обращении строится полноценный каталог с роутером
+class MappedRequestHandler {
+public:
+    explicit MappedRequestHandler(const catalogue_image::CatalogueView& view);
+
+    std::optional<transport_catalogue::BusInfo> GetBusStat(const std::string& bus_name) const;
+    std::optional<catalogue_image::BusNameRange> GetBusesByStop(const std::string& stop_name) const;
+    std::optional<catalogue_image::StopId> FindStop(const std::string& stop_name) const;
+
+    svg::Document RenderMap() const;
+    std::shared_ptr<const std::string> GetEncodedMap(json::Encoding encoding) const;
+    std::optional<TransportRouter::RouteResult> BuildRoute(std::string_view from, std::string_view to) const;
+
+    // Отображённый образ и, если он уже построен, полноценный каталог
+    memory_stats::Report GetMemoryStats() const;
+
+private:
+    const CatalogueSnapshot& GetSnapshot() const;
+
+    const catalogue_image::CatalogueView& view_;
+    mutable std::once_flag snapshot_flag_;
+    mutable std::unique_ptr<const CatalogueSnapshot> snapshot_;
+    mutable std::atomic<bool> materialized_{ false };
+};
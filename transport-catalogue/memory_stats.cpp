@@ -0,0 +1,96 @@
+#include "memory_stats.h"
+
+#include <limits>
+#include <variant>
+
+namespace memory_stats {
+
+    namespace {
+
+        struct JsonCounter {
+            size_t nodes = 0;
+            size_t bytes = 0;
+
+            void Visit(const json::Node& node) {
+                ++nodes;
+                std::visit(*this, node.GetValue());
+            }
+
+            void operator()(const json::Array& array) {
+                bytes += (array.capacity() - array.size()) * sizeof(json::Node);
+                for (const auto& item : array) {
+                    bytes += sizeof(json::Node);
+                    Visit(item);
+                }
+            }
+
+            void operator()(const json::Dict& dict) {
+                bytes += dict.capacity() * sizeof(json::Dict::value_type);
+                for (const auto& [key, value] : dict) {
+                    bytes += StringBytes(key);
+                    Visit(value);
+                }
+            }
+
+            void operator()(const std::string& str) {
+                bytes += StringBytes(str);
+            }
+
+            template <typename Scalar>
+            void operator()(const Scalar&) {
+            }
+        };
+
+        // В JSON есть только int и double; большие значения уходят в double
+        json::Node SizeToJson(size_t value) {
+            if (value <= static_cast<size_t>(std::numeric_limits<int>::max())) {
+                return static_cast<int>(value);
+            }
+            return static_cast<double>(value);
+        }
+
+    } // namespace
+
+    size_t GetTotalBytes(const Report& report) {
+        size_t total = 0;
+        for (const auto& entry : report) {
+            total += entry.bytes;
+        }
+        return total;
+    }
+
+    void PrintReport(std::ostream& output, std::string_view phase, const Report& report) {
+        output << "memory after " << phase << ": " << GetTotalBytes(report) << " bytes\n";
+        for (const auto& entry : report) {
+            output << "  " << entry.name << ": " << entry.bytes << " bytes, " << entry.count << " objects\n";
+        }
+    }
+
+    json::Node ReportToJson(const Report& report) {
+        json::Dict containers;
+        for (const auto& entry : report) {
+            containers[entry.name] = json::Dict{
+                { "bytes", SizeToJson(entry.bytes) },
+                { "count", SizeToJson(entry.count) },
+            };
+        }
+        return json::Dict{
+            { "total_bytes", SizeToJson(GetTotalBytes(report)) },
+            { "containers", std::move(containers) },
+        };
+    }
+
+    Entry CollectJson(std::string name, const json::Node& root) {
+        JsonCounter counter;
+        counter.bytes = sizeof(json::Node);
+        counter.Visit(root);
+        return { std::move(name), counter.nodes, counter.bytes };
+    }
+
+    Entry CollectJson(std::string name, const json::Array& array) {
+        JsonCounter counter;
+        counter(array);
+        return { std::move(name), counter.nodes, counter.bytes };
+    }
+
+} // namespace memory_stats
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace memory_stats {
+
+    // Занимаемая память и число объектов в одном крупном контейнере.
+    // Байты — оценка по ёмкости контейнеров и размерам их узлов,
+    // без учёта служебных данных аллокатора
+    struct Entry {
+        std::string name;
+        size_t count = 0;
+        size_t bytes = 0;
+    };
+
+    using Report = std::vector<Entry>;
+
+    size_t GetTotalBytes(const Report& report);
+
+    // Печатает отчёт одной строкой на контейнер, например для дампа в stderr
+    void PrintReport(std::ostream& output, std::string_view phase, const Report& report);
+
+    // { "total_bytes": ..., "containers": { имя: { "bytes": ..., "count": ... } } }
+    json::Node ReportToJson(const Report& report);
+
+    // Дерево разобранного JSON-документа
+    Entry CollectJson(std::string name, const json::Node& root);
+    Entry CollectJson(std::string name, const json::Array& array);
+
+    // Память строки вне самого объекта std::string (короткие строки хранятся внутри)
+    inline size_t StringBytes(const std::string& str) {
+        static const size_t inline_capacity = std::string().capacity();
+        return str.capacity() > inline_capacity ? str.capacity() + 1 : 0;
+    }
+
+    template <typename T>
+    size_t VectorBytes(const std::vector<T>& vector) {
+        return vector.capacity() * sizeof(T);
+    }
+
+    template <typename T>
+    size_t DequeBytes(const std::deque<T>& deque) {
+        return deque.size() * sizeof(T);
+    }
+
+    // Узел хеш-таблицы: указатель на следующий узел, значение и сохранённый хеш
+    template <typename HashMap>
+    size_t HashMapBytes(const HashMap& map) {
+        return map.bucket_count() * sizeof(void*)
+            + map.size() * (sizeof(void*) + sizeof(typename HashMap::value_type) + sizeof(size_t));
+    }
+
+    // Узел красно-чёрного дерева: цвет и три указателя
+    template <typename Map>
+    size_t TreeMapBytes(const Map& map) {
+        return map.size() * (4 * sizeof(void*) + sizeof(typename Map::value_type));
+    }
+
+} // namespace memory_stats
@@ -0,0 +1,164 @@
+#include "metrics.h"
+
+#ifdef TC_METRICS
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace metrics {
+
+    namespace {
+
+        constexpr size_t PROBE_COUNT = static_cast<size_t>(Probe::COUNT);
+
+        constexpr std::array<std::string_view, PROBE_COUNT> PROBE_NAMES = {
+            "request.Bus",
+            "request.Stop",
+            "request.Map",
+            "request.Route",
+            "request.Stats",
+            "handler.GetBusStat",
+            "handler.GetBusesByStop",
+            "handler.FindStop",
+            "handler.RenderMap",
+            "handler.GetEncodedMap",
+            "handler.BuildRoute",
+            "handler.GetMemoryStats",
+        };
+
+        std::array<Histogram, PROBE_COUNT> histograms;
+
+        // Номер старшего единичного бита; value > 0
+        int Log2(uint64_t value) {
+            int result = 0;
+            for (int shift = 32; shift > 0; shift /= 2) {
+                if (value >> shift) {
+                    value >>= shift;
+                    result += shift;
+                }
+            }
+            return result;
+        }
+
+        json::Node CountToJson(uint64_t value) {
+            if (value <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+                return static_cast<int>(value);
+            }
+            return static_cast<double>(value);
+        }
+
+        json::Node NanosecondsToMicros(uint64_t value) {
+            return static_cast<double>(value) / 1000.0;
+        }
+
+        // Печатает отчёт при выходе, если что-то было замерено
+        struct ReportAtExit {
+            ~ReportAtExit() {
+                PrintReport(std::cerr);
+            }
+        };
+        const ReportAtExit report_at_exit;
+
+    } // namespace
+
+    void Histogram::Record(uint64_t value) {
+        buckets_[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    size_t Histogram::GetBucket(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        // Старшие SUB_BUCKET_BITS + 1 бит значения: первый всегда единица
+        const int shift = Log2(value) - SUB_BUCKET_BITS;
+        const uint64_t mantissa = value >> shift;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKET_COUNT + (mantissa - SUB_BUCKET_COUNT));
+    }
+
+    uint64_t Histogram::GetBucketMax(size_t bucket) {
+        if (bucket < SUB_BUCKET_COUNT) {
+            return bucket;
+        }
+        const int shift = static_cast<int>(bucket / SUB_BUCKET_COUNT) - 1;
+        const uint64_t mantissa = SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    Summary Histogram::Summarize() const {
+        // Снимок корзин: записи, пришедшие во время подсчёта, могут не попасть в него
+        std::array<uint64_t, BUCKET_COUNT> counts;
+        Summary summary;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            summary.count += counts[i];
+        }
+        summary.max = max_.load(std::memory_order_relaxed);
+        if (summary.count == 0) {
+            return summary;
+        }
+
+        auto percentile = [&](uint64_t per_mille) {
+            const uint64_t rank = std::max<uint64_t>(1, (summary.count * per_mille + 999) / 1000);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    return std::min(GetBucketMax(i), summary.max);
+                }
+            }
+            return summary.max;
+        };
+        summary.p50 = percentile(500);
+        summary.p90 = percentile(900);
+        summary.p99 = percentile(990);
+        return summary;
+    }
+
+    Histogram& GetHistogram(Probe probe) {
+        return histograms[static_cast<size_t>(probe)];
+    }
+
+    json::Node ReportToJson() {
+        json::Dict report;
+        for (size_t i = 0; i < PROBE_COUNT; ++i) {
+            const Summary summary = histograms[i].Summarize();
+            if (summary.count == 0) {
+                continue;
+            }
+            report[std::string(PROBE_NAMES[i])] = json::Dict{
+                { "count", CountToJson(summary.count) },
+                { "max_us", NanosecondsToMicros(summary.max) },
+                { "p50_us", NanosecondsToMicros(summary.p50) },
+                { "p90_us", NanosecondsToMicros(summary.p90) },
+                { "p99_us", NanosecondsToMicros(summary.p99) },
+            };
+        }
+        return report;
+    }
+
+    void PrintReport(std::ostream& output) {
+        bool has_header = false;
+        for (size_t i = 0; i < PROBE_COUNT; ++i) {
+            const Summary summary = histograms[i].Summarize();
+            if (summary.count == 0) {
+                continue;
+            }
+            if (!has_header) {
+                output << "request latency, us:\n";
+                has_header = true;
+            }
+            output << "  " << PROBE_NAMES[i] << ": " << summary.count << " calls"
+                   << ", p50 " << summary.p50 / 1000.0
+                   << ", p90 " << summary.p90 / 1000.0
+                   << ", p99 " << summary.p99 / 1000.0
+                   << ", max " << summary.max / 1000.0 << '\n';
+        }
+    }
+
+} // namespace metrics
+
+#endif
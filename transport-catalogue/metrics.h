@@ -0,0 +1,111 @@
+#pragma once
+
+#include "json.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Счётчики и гистограммы задержек запросов. Собираются, только если программа
+// собрана с макросом TC_METRICS (например, -DTC_METRICS). Без него TC_METRICS_SCOPE
+// раскрывается в пустой оператор, и в обработке запросов не остаётся ни чтений часов,
+// ни самих гистограмм
+namespace metrics {
+
+    // Что измеряется: запросы целиком, по типам, и методы RequestHandler
+    enum class Probe {
+        BUS_REQUEST,
+        STOP_REQUEST,
+        MAP_REQUEST,
+        ROUTE_REQUEST,
+        STATS_REQUEST,
+        GET_BUS_STAT,
+        GET_BUSES_BY_STOP,
+        FIND_STOP,
+        RENDER_MAP,
+        GET_ENCODED_MAP,
+        BUILD_ROUTE,
+        GET_MEMORY_STATS,
+        COUNT,
+    };
+
+#ifdef TC_METRICS
+
+    // Задержки в наносекундах
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t max = 0;
+    };
+
+    // Гистограмма в духе HDR: значения меньше 16 хранятся точно, а каждая следующая
+    // степень двойки делится на 16 корзин, так что перцентиль завышен не больше чем
+    // на 1/16. Запись — пара атомарных операций без блокировок, её ведут потоки пула
+    class Histogram {
+    public:
+        void Record(uint64_t value);
+        Summary Summarize() const;
+
+    private:
+        static constexpr int SUB_BUCKET_BITS = 4;
+        static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << SUB_BUCKET_BITS;
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        static size_t GetBucket(uint64_t value);
+        // Наибольшее значение, попадающее в корзину
+        static uint64_t GetBucketMax(size_t bucket);
+
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+        std::atomic<uint64_t> max_{ 0 };
+    };
+
+    Histogram& GetHistogram(Probe probe);
+
+    // Время от создания до разрушения. steady_clock в Linux читается через vDSO,
+    // без системного вызова
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Probe probe)
+            : probe_(probe)
+            , start_(std::chrono::steady_clock::now()) {
+        }
+
+        ~ScopedTimer() {
+            const auto elapsed = std::chrono::steady_clock::now() - start_;
+            GetHistogram(probe_).Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Probe probe_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // { имя: { "count": ..., "max_us": ..., "p50_us": ..., "p90_us": ..., "p99_us": ... } }
+    // для замеров, у которых есть хотя бы одна запись
+    json::Node ReportToJson();
+    // Одна строка на замер; печатается в stderr и при выходе из программы
+    void PrintReport(std::ostream& output);
+
+#endif
+
+} // namespace metrics
+
+#ifdef TC_METRICS
+#define TC_METRICS_CONCAT_IMPL(a, b) a##b
+#define TC_METRICS_CONCAT(a, b) TC_METRICS_CONCAT_IMPL(a, b)
+// Замеряет время до конца текущего блока, например TC_METRICS_SCOPE(BUILD_ROUTE)
+#define TC_METRICS_SCOPE(probe) \
+    const ::metrics::ScopedTimer TC_METRICS_CONCAT(metrics_timer_, __LINE__)(::metrics::Probe::probe)
+#else
+#define TC_METRICS_SCOPE(probe) static_cast<void>(0)
+#endif
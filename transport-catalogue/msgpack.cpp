@@ -0,0 +1,383 @@
+#include "msgpack.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <utility>
+
+namespace msgpack {
+
+namespace {
+using namespace std::literals;
+
+// Коды типов MessagePack
+constexpr uint8_t NIL = 0xc0;
+constexpr uint8_t FALSE = 0xc2;
+constexpr uint8_t TRUE = 0xc3;
+constexpr uint8_t FLOAT32 = 0xca;
+constexpr uint8_t FLOAT64 = 0xcb;
+constexpr uint8_t UINT8 = 0xcc;
+constexpr uint8_t UINT16 = 0xcd;
+constexpr uint8_t UINT32 = 0xce;
+constexpr uint8_t UINT64 = 0xcf;
+constexpr uint8_t INT8 = 0xd0;
+constexpr uint8_t INT16 = 0xd1;
+constexpr uint8_t INT32 = 0xd2;
+constexpr uint8_t INT64 = 0xd3;
+constexpr uint8_t STR8 = 0xd9;
+constexpr uint8_t STR16 = 0xda;
+constexpr uint8_t STR32 = 0xdb;
+constexpr uint8_t ARRAY16 = 0xdc;
+constexpr uint8_t ARRAY32 = 0xdd;
+constexpr uint8_t MAP16 = 0xde;
+constexpr uint8_t MAP32 = 0xdf;
+constexpr uint8_t FIXMAP = 0x80;
+constexpr uint8_t FIXARRAY = 0x90;
+constexpr uint8_t FIXSTR = 0xa0;
+
+// Целое в порядке big-endian, как требует формат
+template <typename T>
+void PutBig(T value, char* dest) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        dest[i] = static_cast<char>(static_cast<uint8_t>(value >> (8 * (sizeof(T) - 1 - i))));
+    }
+}
+
+template <typename T>
+void WriteTyped(uint8_t type, T value, json::OutputBuffer& out) {
+    char bytes[1 + sizeof(T)];
+    bytes[0] = static_cast<char>(type);
+    PutBig(value, bytes + 1);
+    out.Write(std::string_view(bytes, sizeof(bytes)));
+}
+
+ContainerHeader MakeHeader(size_t count, uint8_t fix_type, uint8_t type16, uint8_t type32) {
+    ContainerHeader header;
+    if (count < 16) {
+        header.bytes[0] = static_cast<char>(fix_type | count);
+        header.size = 1;
+    } else if (count <= std::numeric_limits<uint16_t>::max()) {
+        header.bytes[0] = static_cast<char>(type16);
+        PutBig(static_cast<uint16_t>(count), header.bytes + 1);
+        header.size = 3;
+    } else {
+        header.bytes[0] = static_cast<char>(type32);
+        PutBig(static_cast<uint32_t>(count), header.bytes + 1);
+        header.size = 5;
+    }
+    return header;
+}
+
+class Decoder {
+public:
+    explicit Decoder(std::string_view input)
+        : pos_(input.data())
+        , end_(input.data() + input.size()) {
+    }
+
+    // Как и у JSON, значение каждого ключа корневого словаря — в своей арене
+    json::Node LoadRoot(json::DocumentMemory& memory) {
+        resource_ = &memory.root;
+        const uint8_t type = ReadByte();
+        size_t count = 0;
+        if (!ReadMapSize(type, count)) {
+            return LoadNodeOfType(type);
+        }
+        return LoadMap(count, [this, &memory](const std::string& key) {
+            resource_ = &memory.members[key];
+            json::Node value = LoadNode();
+            resource_ = &memory.root;
+            return value;
+        });
+    }
+
+private:
+    uint8_t ReadByte() {
+        if (pos_ == end_) {
+            throw json::ParsingError("Unexpected end of MessagePack data"s);
+        }
+        return static_cast<uint8_t>(*pos_++);
+    }
+
+    std::string_view ReadBytes(size_t count) {
+        if (static_cast<size_t>(end_ - pos_) < count) {
+            throw json::ParsingError("Unexpected end of MessagePack data"s);
+        }
+        std::string_view bytes(pos_, count);
+        pos_ += count;
+        return bytes;
+    }
+
+    template <typename T>
+    T ReadBig() {
+        const std::string_view bytes = ReadBytes(sizeof(T));
+        uint64_t value = 0;
+        for (const char c : bytes) {
+            value = (value << 8) | static_cast<uint8_t>(c);
+        }
+        return static_cast<T>(value);
+    }
+
+    template <typename T>
+    T ReadFloat() {
+        using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+        const Bits bits = ReadBig<Bits>();
+        T value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool ReadMapSize(uint8_t type, size_t& count) {
+        if ((type & 0xf0) == FIXMAP) {
+            count = type & 0x0f;
+        } else if (type == MAP16) {
+            count = ReadBig<uint16_t>();
+        } else if (type == MAP32) {
+            count = ReadBig<uint32_t>();
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Целые вне диапазона int становятся double, как при разборе JSON
+    static json::Node MakeInteger(int64_t value) {
+        if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+            return static_cast<int>(value);
+        }
+        return static_cast<double>(value);
+    }
+
+    static json::Node MakeInteger(uint64_t value) {
+        if (value <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+            return static_cast<int>(value);
+        }
+        return static_cast<double>(value);
+    }
+
+    json::Node LoadNode() {
+        return LoadNodeOfType(ReadByte());
+    }
+
+    json::Node LoadNodeOfType(uint8_t type) {
+        if (type <= 0x7f) {
+            return static_cast<int>(type);
+        }
+        if (type >= 0xe0) {
+            return static_cast<int>(static_cast<int8_t>(type));
+        }
+        if ((type & 0xe0) == FIXSTR) {
+            return LoadString(type & 0x1f);
+        }
+        if ((type & 0xf0) == FIXARRAY) {
+            return LoadArray(type & 0x0f);
+        }
+        size_t count = 0;
+        if (ReadMapSize(type, count)) {
+            return LoadMap(count, [this](const std::string&) {
+                return LoadNode();
+            });
+        }
+
+        switch (type) {
+            case NIL:
+                return nullptr;
+            case FALSE:
+                return false;
+            case TRUE:
+                return true;
+            case FLOAT32:
+                return static_cast<double>(ReadFloat<float>());
+            case FLOAT64:
+                return ReadFloat<double>();
+            case UINT8:
+                return static_cast<int>(ReadBig<uint8_t>());
+            case UINT16:
+                return static_cast<int>(ReadBig<uint16_t>());
+            case UINT32:
+                return MakeInteger(static_cast<uint64_t>(ReadBig<uint32_t>()));
+            case UINT64:
+                return MakeInteger(ReadBig<uint64_t>());
+            case INT8:
+                return static_cast<int>(ReadBig<int8_t>());
+            case INT16:
+                return static_cast<int>(ReadBig<int16_t>());
+            case INT32:
+                return static_cast<int>(ReadBig<int32_t>());
+            case INT64:
+                return MakeInteger(static_cast<int64_t>(ReadBig<uint64_t>()));
+            case STR8:
+                return LoadString(ReadBig<uint8_t>());
+            case STR16:
+                return LoadString(ReadBig<uint16_t>());
+            case STR32:
+                return LoadString(ReadBig<uint32_t>());
+            case ARRAY16:
+                return LoadArray(ReadBig<uint16_t>());
+            case ARRAY32:
+                return LoadArray(ReadBig<uint32_t>());
+            default: {
+                static constexpr char digits[] = "0123456789abcdef";
+                throw json::ParsingError("Unsupported MessagePack type 0x"s
+                                         + digits[type >> 4] + digits[type & 0x0f]);
+            }
+        }
+    }
+
+    json::Node LoadString(size_t size) {
+        return std::string(ReadBytes(size));
+    }
+
+    // Каждый элемент занимает хотя бы байт, поэтому резерв не больше остатка входа:
+    // испорченный размер не приводит к огромному выделению памяти
+    size_t ReserveFor(size_t count) const {
+        return std::min(count, static_cast<size_t>(end_ - pos_));
+    }
+
+    json::Node LoadArray(size_t count) {
+        json::Array result(resource_);
+        result.reserve(ReserveFor(count));
+        for (size_t i = 0; i < count; ++i) {
+            result.push_back(LoadNode());
+        }
+        return json::Node(std::move(result));
+    }
+
+    template <typename LoadValue>
+    json::Node LoadMap(size_t count, LoadValue load_value) {
+        json::Dict::Items items(resource_);
+        items.reserve(ReserveFor(count));
+        for (size_t i = 0; i < count; ++i) {
+            json::Node key = LoadNode();
+            if (!key.IsString()) {
+                throw json::ParsingError("MessagePack map key must be a string"s);
+            }
+            std::string name = key.AsString();
+            json::Node value = load_value(name);
+            items.emplace_back(std::move(name), std::move(value));
+        }
+
+        auto less = [](const json::Dict::value_type& lhs, const json::Dict::value_type& rhs) {
+            return lhs.first < rhs.first;
+        };
+        std::sort(items.begin(), items.end(), less);
+        auto equal = [](const json::Dict::value_type& lhs, const json::Dict::value_type& rhs) {
+            return lhs.first == rhs.first;
+        };
+        if (auto it = std::adjacent_find(items.begin(), items.end(), equal); it != items.end()) {
+            throw json::ParsingError("Duplicate key '"s + it->first + "' have been found"s);
+        }
+        return json::Node(json::Dict(std::move(items)));
+    }
+
+    const char* pos_;
+    const char* end_;
+    // Откуда выделяется память массивов и словарей
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+};
+
+}  // namespace
+
+json::Document Load(std::string_view input) {
+    auto memory = std::make_unique<json::DocumentMemory>();
+    Decoder decoder(input);
+    json::Node root = decoder.LoadRoot(*memory);
+    return json::Document(std::move(root), std::move(memory));
+}
+
+json::Document Load(std::istream& input) {
+    const std::string data{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    return Load(std::string_view(data));
+}
+
+void WriteNil(json::OutputBuffer& out) {
+    out.Put(static_cast<char>(NIL));
+}
+
+void WriteBool(bool value, json::OutputBuffer& out) {
+    out.Put(static_cast<char>(value ? TRUE : FALSE));
+}
+
+void WriteInt(int value, json::OutputBuffer& out) {
+    if (value >= 0) {
+        if (value <= 0x7f) {
+            out.Put(static_cast<char>(value));
+        } else if (value <= std::numeric_limits<uint8_t>::max()) {
+            WriteTyped(UINT8, static_cast<uint8_t>(value), out);
+        } else if (value <= std::numeric_limits<uint16_t>::max()) {
+            WriteTyped(UINT16, static_cast<uint16_t>(value), out);
+        } else {
+            WriteTyped(UINT32, static_cast<uint32_t>(value), out);
+        }
+    } else if (value >= -32) {
+        out.Put(static_cast<char>(value));
+    } else if (value >= std::numeric_limits<int8_t>::min()) {
+        WriteTyped(INT8, static_cast<uint8_t>(value), out);
+    } else if (value >= std::numeric_limits<int16_t>::min()) {
+        WriteTyped(INT16, static_cast<uint16_t>(value), out);
+    } else {
+        WriteTyped(INT32, static_cast<uint32_t>(value), out);
+    }
+}
+
+void WriteDouble(double value, json::OutputBuffer& out) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    WriteTyped(FLOAT64, bits, out);
+}
+
+void WriteString(std::string_view value, json::OutputBuffer& out) {
+    const size_t size = value.size();
+    if (size < 32) {
+        out.Put(static_cast<char>(FIXSTR | size));
+    } else if (size <= std::numeric_limits<uint8_t>::max()) {
+        WriteTyped(STR8, static_cast<uint8_t>(size), out);
+    } else if (size <= std::numeric_limits<uint16_t>::max()) {
+        WriteTyped(STR16, static_cast<uint16_t>(size), out);
+    } else {
+        WriteTyped(STR32, static_cast<uint32_t>(size), out);
+    }
+    out.Write(value);
+}
+
+ContainerHeader MakeArrayHeader(size_t count) {
+    return MakeHeader(count, FIXARRAY, ARRAY16, ARRAY32);
+}
+
+ContainerHeader MakeMapHeader(size_t count) {
+    return MakeHeader(count, FIXMAP, MAP16, MAP32);
+}
+
+void WriteNode(const json::Node& node, json::OutputBuffer& out) {
+    if (node.IsNull()) {
+        WriteNil(out);
+    } else if (node.IsBool()) {
+        WriteBool(node.AsBool(), out);
+    } else if (node.IsInt()) {
+        WriteInt(node.AsInt(), out);
+    } else if (node.IsPureDouble()) {
+        WriteDouble(node.AsDouble(), out);
+    } else if (node.IsString()) {
+        WriteString(node.AsString(), out);
+    } else if (node.IsArray()) {
+        const json::Array& array = node.AsArray();
+        out.Write(MakeArrayHeader(array.size()).Get());
+        for (const json::Node& element : array) {
+            WriteNode(element, out);
+        }
+    } else {
+        const json::Dict& dict = node.AsDict();
+        out.Write(MakeMapHeader(dict.size()).Get());
+        for (const auto& [key, value] : dict) {
+            WriteString(key, out);
+            WriteNode(value, out);
+        }
+    }
+}
+
+}  // namespace msgpack
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <istream>
+#include <string_view>
+
+// Кодирование json::Node в MessagePack и обратно. Типы соответствуют JSON:
+// null, bool, int, double, строки, массивы и словари со строковыми ключами.
+// int записывается самым коротким целым, double — всегда 8-байтным float64,
+// так что координаты и время передаются без потери точности и без форматирования
+namespace msgpack {
+
+    // Разбирает документ из буфера; данные после корневого значения игнорируются.
+    // Целые вне диапазона int становятся double, как и при разборе JSON; float32 читается
+    // как double. bin и ext не поддерживаются. Ошибки — json::ParsingError
+    json::Document Load(std::string_view input);
+    // Читает поток до конца
+    json::Document Load(std::istream& input);
+
+    // Записи отдельных значений, для тех, кто кодирует без построения Node
+    void WriteNil(json::OutputBuffer& out);
+    void WriteBool(bool value, json::OutputBuffer& out);
+    void WriteInt(int value, json::OutputBuffer& out);
+    void WriteDouble(double value, json::OutputBuffer& out);
+    void WriteString(std::string_view value, json::OutputBuffer& out);
+    void WriteNode(const json::Node& node, json::OutputBuffer& out);
+
+    // Самый длинный заголовок массива или словаря: тип и 32-битный размер
+    inline constexpr size_t MAX_HEADER_SIZE = 5;
+
+    // Заголовок наименьшей длины для массива или словаря из count элементов
+    struct ContainerHeader {
+        char bytes[MAX_HEADER_SIZE] = {};
+        size_t size = 0;
+
+        std::string_view Get() const {
+            return { bytes, size };
+        }
+    };
+
+    ContainerHeader MakeArrayHeader(size_t count);
+    ContainerHeader MakeMapHeader(size_t count);
+
+} // namespace msgpack
@@ -0,0 +1,42 @@
+#include "name_pool.h"
+#include "memory_stats.h"
+
+#include <functional>
+
+namespace transport_catalogue {
+
+    std::string_view NamePool::Intern(std::string_view name) {
+        Shard& shard = shards_[std::hash<std::string_view>{}(name) % SHARD_COUNT];
+        std::lock_guard lock(shard.mutex);
+        if (auto it = shard.names.find(name); it != shard.names.end()) {
+            return *it;
+        }
+        const std::string_view stored = shard.storage.emplace_back(name);
+        shard.names.insert(stored);
+        return stored;
+    }
+
+    size_t NamePool::GetSize() const {
+        size_t size = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            size += shard.names.size();
+        }
+        return size;
+    }
+
+    size_t NamePool::GetMemoryUsage() const {
+        using namespace memory_stats;
+
+        size_t bytes = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            bytes += DequeBytes(shard.storage) + HashMapBytes(shard.names);
+            for (const std::string& name : shard.storage) {
+                bytes += StringBytes(name);
+            }
+        }
+        return bytes;
+    }
+
+} // namespace transport_catalogue
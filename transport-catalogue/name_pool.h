@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace transport_catalogue {
+
+    // Имена остановок и автобусов. Каждое имя хранится один раз, а объекты каталога
+    // ссылаются на него через string_view. Имена не удаляются, поэтому ссылки действительны,
+    // пока жив пул. Пулом владеют каталоги через shared_ptr: один пул можно разделить между
+    // несколькими каталогами (городами CityRegistry или версиями CatalogueService), и общие
+    // для них имена хранятся один раз. Чтобы избавиться от имён удалённых объектов, каталог
+    // копируют в новый пул, а старый освобождается вместе с последним ссылающимся на него каталогом.
+    // Intern можно вызывать из нескольких потоков
+    class NamePool {
+    public:
+        std::string_view Intern(std::string_view name);
+
+        size_t GetSize() const;
+        // Оценка для memory_stats
+        size_t GetMemoryUsage() const;
+
+    private:
+        // Пул разбит на части по хешу имени, чтобы параллельная загрузка
+        // нескольких каталогов не упиралась в одну блокировку
+        static constexpr size_t SHARD_COUNT = 16;
+
+        struct Shard {
+            mutable std::mutex mutex;
+            // Элементы deque не перемещаются при добавлении, и string_view на них не портятся
+            std::deque<std::string> storage;
+            std::unordered_set<std::string_view> names;
+        };
+
+        std::array<Shard, SHARD_COUNT> shards_;
+    };
+
+} // namespace transport_catalogue
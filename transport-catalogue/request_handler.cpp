@@ -1,13 +1,34 @@
 #include "request_handler.h"
+#include "metrics.h"
 
 #include <algorithm>
+#include <chrono>
+#include <sstream>
 
 RequestHandler::RequestHandler(const transport_catalogue::TransportCatalogue& db,
                                const map_renderer::MapRenderer& renderer,
                                const TransportRouter* router)
     : db_(db), renderer_(renderer), router_(router) {}
 
+RequestHandler::RequestHandler(const transport_catalogue::TransportCatalogue& db,
+                               const map_renderer::MapRenderer& renderer,
+                               PendingRouter router)
+    : db_(db), renderer_(renderer), pending_router_(std::move(router)) {}
+
+bool RequestHandler::IsRouterReady() const {
+    return !pending_router_.valid()
+        || pending_router_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+const TransportRouter* RequestHandler::GetRouter() const {
+    if (pending_router_.valid()) {
+        return pending_router_.get().get();
+    }
+    return router_;
+}
+
 std::optional<transport_catalogue::BusInfo> RequestHandler::GetBusStat(const std::string& bus_name) const {
+    TC_METRICS_SCOPE(GET_BUS_STAT);
     auto info = db_.GetBusInfo(bus_name);
     if (!info.has_value() || info->stops_count == 0) {
         return std::nullopt;
@@ -16,27 +37,30 @@ std::optional<transport_catalogue::BusInfo> RequestHandler::GetBusStat(const std
 }
 
 const domain::Stop* RequestHandler::FindStop(const std::string& stop_name) const {
+    TC_METRICS_SCOPE(FIND_STOP);
     return db_.FindStop(stop_name);
 }
 
 
-const std::unordered_set<std::string_view>* RequestHandler::GetBusesByStop(const std::string& stop_name) const {
+const std::vector<std::string_view>* RequestHandler::GetBusesByStop(const std::string& stop_name) const {
+    TC_METRICS_SCOPE(GET_BUSES_BY_STOP);
     const domain::Stop* stop = db_.FindStop(stop_name);
     if (!stop) {
         return nullptr; // возвращаем nullptr только если остановки не существует*/
     }
-    // Всегда возвращаем указатель на множество, даже если оно пустое
+    // Всегда возвращаем указатель на список, даже если он пустой
     // (это означает, что остановка существует, но через нее не проходят автобусы
     return &db_.GetBusesForStop(stop_name);
 }
 
 svg::Document RequestHandler::RenderMap() const {
+    TC_METRICS_SCOPE(RENDER_MAP);
     // 1. Все остановки, через которые проходят автобусы
     std::vector<const domain::Stop*> used_stops;
     for (const domain::Stop& stop : db_.GetAllStops()) {
-        const auto* buses = GetBusesByStop(stop.name); // Используем метод GetBusesByStop RequestHandler'a
-
-        if (buses && !buses->empty()) { // Проверяем и указатель, и пустоту{
+        // Напрямую из каталога: остановка уже найдена, а замер GetBusesByStop
+        // должен отражать только запросы Stop
+        if (!db_.GetBusesForStop(stop.name).empty()) {
             used_stops.push_back(&stop);
         }
     }
@@ -86,7 +110,53 @@ svg::Document RequestHandler::RenderMap() const {
     return renderer_.Render(buses, used_stops, projector);
 }
 
+std::shared_ptr<const std::string> RequestHandler::GetEncodedMap(json::Encoding encoding) const {
+    TC_METRICS_SCOPE(GET_ENCODED_MAP);
+    // Метки версий начинаются с 1, поэтому пустой кэш никогда не совпадёт
+    const uint64_t version = db_.GetVersion();
+    std::lock_guard lock(map_mutex_);
+    if (map_cache_.version != version) {
+        map_cache_ = MapCache{};
+        map_cache_.version = version;
+    }
+    auto& encoded = map_cache_.encoded[static_cast<size_t>(encoding)];
+    if (!encoded) {
+        // Отрисовка идёт под блокировкой: одновременные запросы Map дождутся
+        // одного результата вместо того, чтобы рисовать карту параллельно
+        std::ostringstream svg;
+        RenderMap().Render(svg);
+        encoded = std::make_shared<const std::string>(json::EncodeString(svg.str(), encoding));
+    }
+    return encoded;
+}
+
 std::optional<TransportRouter::RouteResult> RequestHandler::BuildRoute(std::string_view from, std::string_view to) const {
-    if (!router_) return std::nullopt;
-    return router_->BuildRoute(from, to);
+    TC_METRICS_SCOPE(BUILD_ROUTE);
+    const TransportRouter* router = GetRouter();
+    if (!router) return std::nullopt;
+    return router->BuildRoute(from, to);
+}
+
+memory_stats::Report RequestHandler::GetMemoryStats() const {
+    TC_METRICS_SCOPE(GET_MEMORY_STATS);
+    memory_stats::Report report = db_.GetMemoryStats();
+    if (const TransportRouter* router = GetRouter()) {
+        auto router_report = router->GetMemoryStats();
+        report.insert(report.end(), router_report.begin(), router_report.end());
+    }
+    const auto& palette = renderer_.GetSettings().color_palette;
+    report.push_back({ "renderer.palette", palette.size(), memory_stats::VectorBytes(palette) });
+
+    memory_stats::Entry map_cache{ "request_handler.map_cache" };
+    {
+        std::lock_guard lock(map_mutex_);
+        for (const auto& encoded : map_cache_.encoded) {
+            if (encoded) {
+                ++map_cache.count;
+                map_cache.bytes += memory_stats::StringBytes(*encoded);
+            }
+        }
+    }
+    report.push_back(std::move(map_cache));
+    return report;
 }
@@ -1,31 +1,68 @@
 #pragma once
 
 #include "transport_catalogue.h"
+#include "json.h"
 #include "map_renderer.h"
 #include "transport_router.h"
+#include "memory_stats.h"
+#include <array>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <vector>
 
 class RequestHandler {
 public:
+    // Роутер, который ещё строится в другом потоке
+    using PendingRouter = std::shared_future<std::unique_ptr<const TransportRouter>>;
+
     RequestHandler(const transport_catalogue::TransportCatalogue& db,
                    const map_renderer::MapRenderer& renderer,
                    const TransportRouter* router = nullptr);
+    // Bus, Stop и Map отвечаются сразу, а BuildRoute и GetMemoryStats дожидаются роутера.
+    // Обработчик владеет роутером вместе с остальными копиями router
+    RequestHandler(const transport_catalogue::TransportCatalogue& db,
+                   const map_renderer::MapRenderer& renderer,
+                   PendingRouter router);
 
     // Основные методы API
     std::optional<transport_catalogue::BusInfo> GetBusStat(const std::string& bus_name) const;
-    const std::unordered_set<std::string_view>* GetBusesByStop(const std::string& stop_name) const;
+    const std::vector<std::string_view>* GetBusesByStop(const std::string& stop_name) const;
     const domain::Stop* FindStop(const std::string& stop_name) const;
 
     // Метод для рендеринга карты
     svg::Document RenderMap() const;
+    // Текст карты, уже закодированный как строковое значение ответа. Кэшируется
+    // до изменения каталога, так что повторные запросы Map только копируют байты.
+    // Можно вызывать из нескольких потоков
+    std::shared_ptr<const std::string> GetEncodedMap(json::Encoding encoding) const;
 
     // Метод для построения маршрута
     std::optional<TransportRouter::RouteResult> BuildRoute(std::string_view from, std::string_view to) const;
 
+    // Память каталога, роутера и настроек рендерера
+    memory_stats::Report GetMemoryStats() const;
+
+    // false, пока роутер строится: тогда BuildRoute и GetMemoryStats будут ждать
+    bool IsRouterReady() const;
+
 private:
+    const TransportRouter* GetRouter() const;
+
     const transport_catalogue::TransportCatalogue& db_;
     const map_renderer::MapRenderer& renderer_;
-    const TransportRouter* router_;
+    const TransportRouter* router_ = nullptr;
+    PendingRouter pending_router_;
+
+    // Закодированные карты для версии каталога version, по одной на кодировку
+    struct MapCache {
+        uint64_t version = 0;
+        std::array<std::shared_ptr<const std::string>, 2> encoded;
+    };
+    mutable std::mutex map_mutex_;
+    mutable MapCache map_cache_;
 };
@@ -0,0 +1,362 @@
+#include "request_server.h"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TC_HAS_UNIX_SOCKETS 1
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+namespace {
+
+    // Размер куска, читаемого из сокета за один вызов
+    constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+    // Больше этого строка запроса быть не может: соединение получает ошибку и закрывается
+    constexpr size_t MAX_LINE_SIZE = 1024 * 1024;
+    // Сколько ждать, пока клиент примет ответ, прежде чем закрыть соединение
+    constexpr int SEND_TIMEOUT_SECONDS = 30;
+
+    bool IsBlank(std::string_view line) {
+        return line.find_first_not_of(" \t\r"sv) == std::string_view::npos;
+    }
+
+    json::PrintSettings MakeLineSettings() {
+        json::PrintSettings settings;
+        // Ответ обязан занимать одну строку
+        settings.compact = true;
+        return settings;
+    }
+
+#ifdef TC_HAS_UNIX_SOCKETS
+
+    class FileDescriptor {
+    public:
+        explicit FileDescriptor(int fd) : fd_(fd) {}
+        ~FileDescriptor() {
+            ::close(fd_);
+        }
+
+        FileDescriptor(const FileDescriptor&) = delete;
+        FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+        int Get() const {
+            return fd_;
+        }
+
+    private:
+        int fd_;
+    };
+
+    // false, если клиент закрыл соединение
+    bool SendAll(int fd, std::string_view data) {
+        while (!data.empty()) {
+            // MSG_NOSIGNAL: закрытое клиентом соединение не должно завершать сервер сигналом
+#ifdef MSG_NOSIGNAL
+            const ssize_t sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+#else
+            const ssize_t sent = ::send(fd, data.data(), data.size(), 0);
+#endif
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+        return true;
+    }
+
+#endif
+
+} // namespace
+
+RequestServer::RequestServer(Answer answer)
+    : answer_(std::move(answer))
+    , settings_(MakeLineSettings()) {
+}
+
+bool RequestServer::AnswerLine(std::string_view line, json::OutputBuffer& out, json::StreamBuilder& builder) const {
+    if (IsBlank(line)) {
+        return false;
+    }
+
+    const size_t start = out.GetData().size();
+    std::optional<int> id;
+    try {
+        const json::Document request = json::Load(line);
+        const json::Node& root = request.GetRoot();
+        if (!root.IsDict()) {
+            throw std::invalid_argument("Request must be a JSON object"s);
+        }
+        if (auto it = root.AsDict().find("id"); it != root.AsDict().end() && it->second.IsInt()) {
+            id = it->second.AsInt();
+        }
+        builder.Reset();
+        answer_(root.AsDict(), builder);
+    } catch (const std::exception& e) {
+        // Отбрасываем недописанный ответ
+        out.Truncate(start);
+        builder.Reset();
+        builder.StartDict().Key("error_message").Value(e.what());
+        if (id) {
+            builder.Key("request_id").Value(*id);
+        }
+        builder.EndDict();
+    }
+    out.Put('\n');
+    return true;
+}
+
+void RequestServer::Serve(std::istream& input, std::ostream& output) const {
+    json::OutputBuffer out;
+    json::StreamBuilder builder(out, settings_);
+    std::string line;
+    while (std::getline(input, line)) {
+        out.Clear();
+        if (AnswerLine(line, out, builder)) {
+            const std::string_view response = out.GetData();
+            output.write(response.data(), static_cast<std::streamsize>(response.size()));
+            output.flush();
+        }
+    }
+}
+
+#ifdef TC_HAS_UNIX_SOCKETS
+
+// Соединение принадлежит потоку poll, пока busy == false, и задаче пула, пока busy == true
+struct RequestServer::Connection {
+    Connection(int fd, const json::PrintSettings& settings)
+        : socket(fd)
+        , builder(out, settings) {
+    }
+
+    FileDescriptor socket;
+    // Прочитанные, но ещё не отвеченные данные; заканчиваются неполной строкой
+    std::string pending;
+    json::OutputBuffer out;
+    json::StreamBuilder builder;
+    bool busy = false;
+    // Клиент закрыл передачу или прислал слишком длинную строку: после ответа соединение закрывается
+    bool closing = false;
+    bool too_long = false;
+    // Ответ не удалось отправить
+    bool failed = false;
+};
+
+void RequestServer::AnswerLines(Connection& connection) const {
+    // Ответы на все пришедшие целиком строки отправляются одной записью
+    connection.out.Clear();
+    const std::string_view pending = connection.pending;
+    size_t begin = 0;
+    for (size_t end = pending.find('\n'); end != std::string_view::npos; end = pending.find('\n', begin)) {
+        AnswerLine(pending.substr(begin, end - begin), connection.out, connection.builder);
+        begin = end + 1;
+    }
+    connection.pending.erase(0, begin);
+    if (connection.too_long) {
+        connection.builder.Reset();
+        connection.builder.StartDict()
+            .Key("error_message").Value("Request line is longer than "s + std::to_string(MAX_LINE_SIZE) + " bytes"s)
+            .EndDict();
+        connection.out.Put('\n');
+    }
+    connection.failed = !SendAll(connection.socket.Get(), connection.out.GetData());
+}
+
+void RequestServer::ServeUnixSocket(const std::string& path, ThreadPool& pool) const {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is too long: "s + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const FileDescriptor listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.Get() < 0) {
+        throw std::runtime_error("Failed to create socket: "s + std::strerror(errno));
+    }
+
+    // Сокет, оставшийся от прошлого запуска, заменяется; другие файлы не трогаем
+    struct stat info {};
+    if (::stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        ::unlink(path.c_str());
+    }
+    if (::bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        throw std::runtime_error("Failed to bind "s + path + ": "s + std::strerror(errno));
+    }
+    if (::listen(listener.Get(), SOMAXCONN) != 0) {
+        throw std::runtime_error("Failed to listen on "s + path + ": "s + std::strerror(errno));
+    }
+
+    // Задачи пула сообщают о завершении через finished и будят poll байтом в канал
+    int wake_fds[2];
+    if (::pipe(wake_fds) != 0) {
+        throw std::runtime_error("Failed to create pipe: "s + std::strerror(errno));
+    }
+    const FileDescriptor wake_read(wake_fds[0]);
+    const FileDescriptor wake_write(wake_fds[1]);
+    // Задача не должна ждать, даже если канал переполнен: poll и так уже разбужен
+    ::fcntl(wake_write.Get(), F_SETFL, O_NONBLOCK);
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::mutex mutex;
+    std::condition_variable all_finished;
+    std::vector<int> finished;
+    size_t busy_count = 0;
+
+    // Задачи ссылаются на соединения, поэтому при выходе по ошибке дожидаемся их
+    struct WaitForTasks {
+        std::mutex& mutex;
+        std::condition_variable& all_finished;
+        const size_t& busy_count;
+        ~WaitForTasks() {
+            std::unique_lock lock(mutex);
+            all_finished.wait(lock, [this] { return busy_count == 0; });
+        }
+    };
+    const WaitForTasks wait_for_tasks{ mutex, all_finished, busy_count };
+
+    auto submit = [&](Connection& connection) {
+        connection.busy = true;
+        {
+            std::lock_guard lock(mutex);
+            ++busy_count;
+        }
+        const int fd = connection.socket.Get();
+        pool.Submit([&, fd, connection = &connection] {
+            try {
+                AnswerLines(*connection);
+            } catch (const std::exception& e) {
+                // Ошибки отдельных запросов уходят клиенту; здесь остаются только отказы самого соединения
+                std::cerr << "Connection failed: "sv << e.what() << '\n';
+                connection->failed = true;
+            }
+            // Всё под блокировкой: после неё ожидающий выход может уничтожить канал и мьютекс
+            std::lock_guard lock(mutex);
+            finished.push_back(fd);
+            --busy_count;
+            const char byte = 0;
+            [[maybe_unused]] const ssize_t written = ::write(wake_write.Get(), &byte, 1);
+            all_finished.notify_all();
+        });
+    };
+
+    std::vector<pollfd> poll_fds;
+    std::vector<char> chunk(READ_CHUNK_SIZE);
+    for (;;) {
+        // Соединения, на чьи строки сейчас отвечает пул, не читаются: следующие запросы клиента
+        // ждут в буфере сокета, и ответы уходят в порядке запросов
+        poll_fds.clear();
+        poll_fds.push_back({ listener.Get(), POLLIN, 0 });
+        poll_fds.push_back({ wake_read.Get(), POLLIN, 0 });
+        for (const auto& [fd, connection] : connections) {
+            if (!connection->busy) {
+                poll_fds.push_back({ fd, POLLIN, 0 });
+            }
+        }
+        if (::poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to poll "s + path + ": "s + std::strerror(errno));
+        }
+
+        if (poll_fds[1].revents != 0) {
+            while (::read(wake_read.Get(), chunk.data(), chunk.size()) == static_cast<ssize_t>(chunk.size())) {
+            }
+            std::vector<int> done;
+            {
+                std::lock_guard lock(mutex);
+                done.swap(finished);
+            }
+            for (const int fd : done) {
+                Connection& connection = *connections.at(fd);
+                connection.busy = false;
+                if (connection.failed || connection.closing) {
+                    connections.erase(fd);
+                }
+            }
+        }
+
+        for (size_t i = 2; i < poll_fds.size(); ++i) {
+            if (poll_fds[i].revents == 0) {
+                continue;
+            }
+            Connection& connection = *connections.at(poll_fds[i].fd);
+            const ssize_t received = ::recv(poll_fds[i].fd, chunk.data(), chunk.size(), MSG_DONTWAIT);
+            if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+                continue;
+            }
+            if (received > 0) {
+                connection.pending.append(chunk.data(), static_cast<size_t>(received));
+            }
+            else {
+                // Последняя строка может быть без перевода строки
+                connection.closing = true;
+                if (!IsBlank(connection.pending)) {
+                    connection.pending.push_back('\n');
+                }
+            }
+
+            // Неполная строка ограничена MAX_LINE_SIZE, иначе клиент без переводов строк занял бы всю память
+            const size_t last_newline = connection.pending.rfind('\n');
+            const size_t tail_start = last_newline == std::string::npos ? 0 : last_newline + 1;
+            if (connection.pending.size() - tail_start > MAX_LINE_SIZE) {
+                connection.pending.resize(tail_start);
+                connection.too_long = true;
+                connection.closing = true;
+            }
+
+            if (connection.closing || last_newline != std::string::npos) {
+                submit(connection);
+            }
+        }
+
+        if (poll_fds[0].revents != 0) {
+            const int fd = ::accept(listener.Get(), nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EWOULDBLOCK) {
+                    continue;
+                }
+                throw std::runtime_error("Failed to accept on "s + path + ": "s + std::strerror(errno));
+            }
+            // Клиент, который не читает ответы, не должен держать поток пула бесконечно
+            const timeval send_timeout{ SEND_TIMEOUT_SECONDS, 0 };
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+            connections.emplace(fd, std::make_unique<Connection>(fd, settings_));
+        }
+    }
+}
+
+#else
+
+struct RequestServer::Connection {
+};
+
+void RequestServer::AnswerLines(Connection& /*connection*/) const {
+}
+
+void RequestServer::ServeUnixSocket(const std::string& /*path*/, ThreadPool& /*pool*/) const {
+    throw std::runtime_error("Unix domain sockets are not supported on this platform"s);
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "json.h"
+#include "json_builder.h"
+#include "thread_pool.h"
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Сервер запросов в формате JSON Lines: каждая строка входа — один запрос того же вида,
+// что и элементы stat_requests, и на неё выводится ровно одна строка с ответом.
+// База загружается один раз до запуска сервера. Строка, которую не удалось разобрать
+// или обработать, получает ответ с error_message, и сервер продолжает работу
+class RequestServer {
+public:
+    // answer(request, builder) печатает ответ на один запрос
+    using Answer = std::function<void(const json::Dict&, json::StreamBuilder&)>;
+
+    explicit RequestServer(Answer answer);
+
+    // Отвечает на запросы из input, пока он не закончится. Каждый ответ сразу отправляется в output
+    void Serve(std::istream& input, std::ostream& output) const;
+
+    // Принимает соединения на Unix-сокете path и обслуживает каждое так же, как Serve.
+    // Все соединения читает один поток через poll, а на пришедшие строки отвечают потоки pool,
+    // поэтому answer должен допускать параллельные вызовы. Клиент без запросов потока не занимает.
+    // Возвращает управление только при ошибке сокета
+    void ServeUnixSocket(const std::string& path, ThreadPool& pool) const;
+
+private:
+    // Дописывает в out ответ на строку line. Пустые строки пропускаются, тогда возвращает false
+    bool AnswerLine(std::string_view line, json::OutputBuffer& out, json::StreamBuilder& builder) const;
+    struct Connection;
+    // Отвечает на все полные строки connection.pending и отправляет ответы клиенту
+    void AnswerLines(Connection& connection) const;
+
+    Answer answer_;
+    json::PrintSettings settings_;
+};
@@ -29,6 +29,9 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    // Память таблицы кратчайших путей в байтах
+    size_t GetMemoryUsage() const;
+
 private:
     struct RouteInternalData {
         Weight weight;
@@ -94,6 +97,15 @@ Router<Weight>::Router(const Graph& graph)
     }
 }
 
+template <typename Weight>
+size_t Router<Weight>::GetMemoryUsage() const {
+    size_t bytes = routes_internal_data_.capacity() * sizeof(typename RoutesInternalData::value_type);
+    for (const auto& row : routes_internal_data_) {
+        bytes += row.capacity() * sizeof(typename RoutesInternalData::value_type::value_type);
+    }
+    return bytes;
+}
+
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
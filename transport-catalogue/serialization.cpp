@@ -0,0 +1,304 @@
+#include "serialization.h"
+
+#include "binary_io.h"
+#include "bulk_loader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace serialization {
+
+    using namespace std::literals;
+
+    namespace {
+
+        constexpr std::string_view MAGIC = "TCB"sv;
+        constexpr uint8_t FORMAT_VERSION = 1;
+
+        // Теги вариантов svg::Color
+        enum class ColorTag : uint8_t {
+            NONE,
+            NAME,
+            RGB,
+            RGBA,
+        };
+
+        void WritePoint(BinaryWriter& writer, svg::Point point) {
+            writer.Write(point.x);
+            writer.Write(point.y);
+        }
+
+        svg::Point ReadPoint(BinaryReader& reader) {
+            const double x = reader.Read<double>();
+            const double y = reader.Read<double>();
+            return { x, y };
+        }
+
+        void WriteColor(BinaryWriter& writer, const svg::Color& color) {
+            if (const auto* name = std::get_if<std::string>(&color)) {
+                writer.Write(ColorTag::NAME);
+                writer.WriteString(*name);
+            }
+            else if (const auto* rgb = std::get_if<svg::Rgb>(&color)) {
+                writer.Write(ColorTag::RGB);
+                writer.Write(rgb->red);
+                writer.Write(rgb->green);
+                writer.Write(rgb->blue);
+            }
+            else if (const auto* rgba = std::get_if<svg::Rgba>(&color)) {
+                writer.Write(ColorTag::RGBA);
+                writer.Write(rgba->red);
+                writer.Write(rgba->green);
+                writer.Write(rgba->blue);
+                writer.Write(rgba->opacity);
+            }
+            else {
+                writer.Write(ColorTag::NONE);
+            }
+        }
+
+        svg::Color ReadColor(BinaryReader& reader) {
+            switch (reader.Read<ColorTag>()) {
+                case ColorTag::NONE:
+                    return svg::NoneColor;
+                case ColorTag::NAME:
+                    return std::string(reader.ReadString());
+                case ColorTag::RGB: {
+                    svg::Rgb rgb;
+                    rgb.red = reader.Read<uint8_t>();
+                    rgb.green = reader.Read<uint8_t>();
+                    rgb.blue = reader.Read<uint8_t>();
+                    return rgb;
+                }
+                case ColorTag::RGBA: {
+                    svg::Rgba rgba;
+                    rgba.red = reader.Read<uint8_t>();
+                    rgba.green = reader.Read<uint8_t>();
+                    rgba.blue = reader.Read<uint8_t>();
+                    rgba.opacity = reader.Read<double>();
+                    return rgba;
+                }
+            }
+            throw SerializationError("Unknown color tag"s);
+        }
+
+        void WriteRenderSettings(BinaryWriter& writer, const map_renderer::RenderSettings& settings) {
+            writer.Write(settings.width);
+            writer.Write(settings.height);
+            writer.Write(settings.padding);
+            writer.Write(settings.line_width);
+            writer.Write(settings.stop_radius);
+            writer.Write(static_cast<int32_t>(settings.bus_label_font_size));
+            WritePoint(writer, settings.bus_label_offset);
+            writer.Write(static_cast<int32_t>(settings.stop_label_font_size));
+            WritePoint(writer, settings.stop_label_offset);
+            WriteColor(writer, settings.underlayer_color);
+            writer.Write(settings.underlayer_width);
+            writer.WriteSize(settings.color_palette.size());
+            for (const auto& color : settings.color_palette) {
+                WriteColor(writer, color);
+            }
+        }
+
+        map_renderer::RenderSettings ReadRenderSettings(BinaryReader& reader) {
+            map_renderer::RenderSettings settings;
+            settings.width = reader.Read<double>();
+            settings.height = reader.Read<double>();
+            settings.padding = reader.Read<double>();
+            settings.line_width = reader.Read<double>();
+            settings.stop_radius = reader.Read<double>();
+            settings.bus_label_font_size = reader.Read<int32_t>();
+            settings.bus_label_offset = ReadPoint(reader);
+            settings.stop_label_font_size = reader.Read<int32_t>();
+            settings.stop_label_offset = ReadPoint(reader);
+            settings.underlayer_color = ReadColor(reader);
+            settings.underlayer_width = reader.Read<double>();
+            // Цвет — хотя бы байт тега
+            const size_t palette_size = reader.ReadCount(sizeof(ColorTag));
+            settings.color_palette.reserve(palette_size);
+            for (size_t i = 0; i < palette_size; ++i) {
+                settings.color_palette.push_back(ReadColor(reader));
+            }
+            return settings;
+        }
+
+        void WriteSettings(BinaryWriter& writer,
+                           const map_renderer::RenderSettings& render_settings,
+                           const TransportRouter::RoutingSettings& routing_settings) {
+            WriteRenderSettings(writer, render_settings);
+            writer.Write(static_cast<int32_t>(routing_settings.bus_wait_time));
+            writer.Write(routing_settings.bus_velocity);
+        }
+
+        BaseSettings ReadSettings(BinaryReader& reader) {
+            BaseSettings settings;
+            settings.render_settings = ReadRenderSettings(reader);
+            settings.routing_settings.bus_wait_time = reader.Read<int32_t>();
+            settings.routing_settings.bus_velocity = reader.Read<double>();
+            return settings;
+        }
+
+    } // namespace
+
+    std::string SerializeSettings(const map_renderer::RenderSettings& render_settings,
+                                  const TransportRouter::RoutingSettings& routing_settings) {
+        std::ostringstream output;
+        {
+            BinaryWriter writer(output);
+            WriteSettings(writer, render_settings, routing_settings);
+        }
+        return output.str();
+    }
+
+    BaseSettings DeserializeSettings(std::string_view data) {
+        BinaryReader reader(data);
+        BaseSettings settings = ReadSettings(reader);
+        if (!reader.AtEnd()) {
+            throw SerializationError("Trailing data after serialized settings"s);
+        }
+        return settings;
+    }
+
+    void Serialize(const transport_catalogue::TransportCatalogue& db,
+                   const map_renderer::RenderSettings& render_settings,
+                   const TransportRouter::RoutingSettings& routing_settings,
+                   std::ostream& output) {
+        BinaryWriter writer(output);
+        for (const char c : MAGIC) {
+            writer.Write(c);
+        }
+        writer.Write(FORMAT_VERSION);
+
+        WriteSettings(writer, render_settings, routing_settings);
+
+        const auto& stops = db.GetAllStops();
+        const auto& distances = db.GetAllDistances();
+        const auto& buses = db.GetAllBuses();
+        writer.WriteSize(stops.size());
+        writer.WriteSize(distances.size());
+        writer.WriteSize(buses.size());
+
+        std::unordered_map<const domain::Stop*, uint32_t> stop_index;
+        stop_index.reserve(stops.size());
+        for (const auto& stop : stops) {
+            stop_index.emplace(&stop, static_cast<uint32_t>(stop_index.size()));
+            writer.WriteString(stop.name);
+            writer.Write(stop.coordinates.lat);
+            writer.Write(stop.coordinates.lng);
+        }
+
+        for (const auto& [stops_pair, distance] : distances) {
+            writer.Write(stop_index.at(stops_pair.first));
+            writer.Write(stop_index.at(stops_pair.second));
+            writer.Write(static_cast<int32_t>(distance));
+        }
+
+        for (const auto& bus : buses) {
+            writer.WriteString(bus.name);
+            writer.Write(static_cast<uint8_t>(bus.is_roundtrip));
+            writer.WriteSize(bus.stops.size());
+            for (const domain::Stop* stop : bus.stops) {
+                writer.Write(stop_index.at(stop));
+            }
+        }
+    }
+
+    TransportBase Deserialize(std::string_view data, ThreadPool* pool,
+                              std::shared_ptr<transport_catalogue::NamePool> names) {
+        BinaryReader reader(data);
+        for (const char c : MAGIC) {
+            if (reader.Read<char>() != c) {
+                throw SerializationError("Not a serialized transport base"s);
+            }
+        }
+        if (reader.Read<uint8_t>() != FORMAT_VERSION) {
+            throw SerializationError("Unsupported serialized base version"s);
+        }
+
+        TransportBase base{ transport_catalogue::TransportCatalogue(std::move(names)), {}, {} };
+        BaseSettings settings = ReadSettings(reader);
+        base.render_settings = std::move(settings.render_settings);
+        base.routing_settings = settings.routing_settings;
+
+        // Наименьшие записи: остановка с пустым именем, расстояние, автобус без имени и остановок
+        const size_t stop_count = reader.ReadCount(sizeof(uint32_t) + 2 * sizeof(double));
+        const size_t distance_count = reader.ReadCount(2 * sizeof(uint32_t) + sizeof(int32_t));
+        const size_t bus_count = reader.ReadCount(2 * sizeof(uint32_t) + sizeof(uint8_t));
+        transport_catalogue::BulkLoader loader(base.db, stop_count, bus_count, distance_count);
+
+        std::vector<const domain::Stop*> stops;
+        stops.reserve(stop_count);
+        for (size_t i = 0; i < stop_count; ++i) {
+            domain::Stop stop;
+            stop.name = reader.ReadString();
+            stop.coordinates.lat = reader.Read<double>();
+            stop.coordinates.lng = reader.Read<double>();
+            stops.push_back(&loader.AddStop(std::move(stop)));
+        }
+
+        auto read_stop = [&reader, &stops]() {
+            const uint32_t index = reader.Read<uint32_t>();
+            if (index >= stops.size()) {
+                throw SerializationError("Stop index is out of range"s);
+            }
+            return stops[index];
+        };
+
+        for (size_t i = 0; i < distance_count; ++i) {
+            const domain::Stop* from = read_stop();
+            const domain::Stop* to = read_stop();
+            loader.AddDistance(from, to, reader.Read<int32_t>());
+        }
+
+        for (size_t i = 0; i < bus_count; ++i) {
+            const std::string_view name = reader.ReadString();
+            const bool is_roundtrip = reader.Read<uint8_t>() != 0;
+            std::vector<const domain::Stop*> bus_stops(reader.ReadCount(sizeof(uint32_t)));
+            for (auto& stop : bus_stops) {
+                stop = read_stop();
+            }
+            loader.AddBus(name, std::move(bus_stops), is_roundtrip);
+        }
+
+        if (!reader.AtEnd()) {
+            throw SerializationError("Trailing data after serialized base"s);
+        }
+
+        loader.Finish(pool);
+        return base;
+    }
+
+    void SaveBase(const transport_catalogue::TransportCatalogue& db,
+                  const map_renderer::RenderSettings& render_settings,
+                  const TransportRouter::RoutingSettings& routing_settings,
+                  const std::string& file) {
+        std::ofstream output(file, std::ios::binary);
+        if (!output) {
+            throw SerializationError("Failed to open "s + file + " for writing"s);
+        }
+        Serialize(db, render_settings, routing_settings, output);
+        if (!output.flush()) {
+            throw SerializationError("Failed to write "s + file);
+        }
+    }
+
+    TransportBase LoadBase(const std::string& file, ThreadPool* pool,
+                           std::shared_ptr<transport_catalogue::NamePool> names) {
+        std::ifstream input(file, std::ios::binary | std::ios::ate);
+        if (!input) {
+            throw SerializationError("Failed to open "s + file);
+        }
+        std::string data(static_cast<size_t>(input.tellg()), '\0');
+        input.seekg(0);
+        if (!input.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+            throw SerializationError("Failed to read "s + file);
+        }
+        return Deserialize(data, pool, std::move(names));
+    }
+
+} // namespace serialization
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "map_renderer.h"
+#include "thread_pool.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+    // Компактный двоичный формат базы (режимы make_base / process_requests).
+    // Все числа пишутся в порядке байт текущей платформы, массивы предваряются длиной,
+    // остановки в расстояниях и маршрутах задаются индексами, а не именами.
+    //
+    // Заголовок: "TCB" + версия формата (1 байт)
+    // RenderSettings, RoutingSettings
+    // u32 stop_count, u32 distance_count, u32 bus_count — чтобы заранее зарезервировать каталог
+    // stops:     stop_count × { string name, f64 lat, f64 lng }
+    // distances: distance_count × { u32 from, u32 to, i32 distance }
+    // buses:     bus_count × { string name, u8 is_roundtrip, u32 k, k × u32 stop }
+    // string:    u32 length + байты
+
+    class SerializationError : public std::runtime_error {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    struct SerializationSettings {
+        std::string file;
+        // Необязательный образ каталога для работы через отображение в память (см. catalogue_image.h)
+        std::string image;
+        // Необязательный журнал изменений базы (см. delta_log.h)
+        std::string delta_log;
+    };
+
+    struct TransportBase {
+        transport_catalogue::TransportCatalogue db;
+        map_renderer::RenderSettings render_settings;
+        TransportRouter::RoutingSettings routing_settings;
+    };
+
+    struct BaseSettings {
+        map_renderer::RenderSettings render_settings;
+        TransportRouter::RoutingSettings routing_settings;
+    };
+
+    // Только настройки визуализации и маршрутизации, в том же двоичном виде, что и в базе
+    std::string SerializeSettings(const map_renderer::RenderSettings& render_settings,
+                                  const TransportRouter::RoutingSettings& routing_settings);
+    BaseSettings DeserializeSettings(std::string_view data);
+
+    void Serialize(const transport_catalogue::TransportCatalogue& db,
+                   const map_renderer::RenderSettings& render_settings,
+                   const TransportRouter::RoutingSettings& routing_settings,
+                   std::ostream& output);
+
+    // Разбирает базу из буфера, целиком прочитанного в память.
+    // Имена попадают в names, если пул передан, иначе в собственный пул каталога
+    TransportBase Deserialize(std::string_view data, ThreadPool* pool = nullptr,
+                              std::shared_ptr<transport_catalogue::NamePool> names = nullptr);
+
+    void SaveBase(const transport_catalogue::TransportCatalogue& db,
+                  const map_renderer::RenderSettings& render_settings,
+                  const TransportRouter::RoutingSettings& routing_settings,
+                  const std::string& file);
+
+    TransportBase LoadBase(const std::string& file, ThreadPool* pool = nullptr,
+                           std::shared_ptr<transport_catalogue::NamePool> names = nullptr);
+
+} // namespace serialization
@@ -139,6 +139,11 @@ Text& Text::SetData(std::string data) {
     return *this;
 }
 
+Text& Text::SetData(std::string_view data) {
+    data_.assign(data);
+    return *this;
+}
+
 void Text::RenderObject(const RenderContext& context) const {
     auto& out = context.out;
     out << "<text";
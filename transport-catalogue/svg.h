@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <variant>
@@ -205,6 +206,8 @@ public:
 
     // Задаёт текстовое содержимое объекта (отображается внутри тега text)
     Text& SetData(std::string data);
+    // То же без промежуточной строки, когда текст уже лежит в другом месте
+    Text& SetData(std::string_view data);
 
 private:
     void RenderObject(const RenderContext& context) const override;
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Пул потоков фиксированного размера. Задачи выполняются в порядке поступления.
+// Задачи не должны сами ждать результатов других задач этого же пула
+class ThreadPool {
+public:
+    // 0 означает число аппаратных потоков
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetThreadCount() const {
+        return workers_.size();
+    }
+
+    template <typename Task>
+    auto Submit(Task task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.emplace([packaged] { (*packaged)(); });
+        }
+        has_tasks_.notify_one();
+        return result;
+    }
+
+private:
+    void Run();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    bool stopping_ = false;
+};
+
+// Делит диапазон [0, count) на куски и вызывает body(begin, end) для каждого куска.
+// Последний кусок выполняется в вызывающем потоке. Без пула или при малом count
+// всё выполняется последовательно
+template <typename Body>
+void ParallelFor(ThreadPool* pool, size_t count, size_t min_chunk, Body body) {
+    const size_t max_chunks = pool ? pool->GetThreadCount() + 1 : 1;
+    const size_t chunks = std::clamp<size_t>(count / std::max<size_t>(min_chunk, 1), 1, max_chunks);
+    if (chunks == 1) {
+        body(size_t{0}, count);
+        return;
+    }
+
+    const size_t chunk_size = (count + chunks - 1) / chunks;
+    std::vector<std::future<void>> futures;
+    futures.reserve(chunks - 1);
+    size_t begin = 0;
+    for (; begin + chunk_size < count; begin += chunk_size) {
+        futures.push_back(pool->Submit([&body, begin, end = begin + chunk_size] { body(begin, end); }));
+    }
+
+    // Дожидаемся всех кусков даже при исключении: задачи ссылаются на body
+    std::exception_ptr error;
+    try {
+        body(begin, count);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (auto& future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -1,24 +1,222 @@
 #include "transport_catalogue.h"
 
 #include <algorithm>
+#include <atomic>
 
 namespace transport_catalogue {
 
+    uint64_t VersionStamp::Next() {
+        static std::atomic<uint64_t> next{ 1 };
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TransportCatalogue::TransportCatalogue()
+        : names_(std::make_shared<NamePool>()) {
+    }
+
+    TransportCatalogue::TransportCatalogue(std::shared_ptr<NamePool> names)
+        : names_(names ? std::move(names) : std::make_shared<NamePool>()) {
+    }
+
+    TransportCatalogue::TransportCatalogue(const TransportCatalogue& other)
+        : names_(other.names_) {
+        CopyFrom(other, other.removed_stops_, other.removed_buses_);
+        // CopyFrom меняет метку при каждом добавлении. Без отложенных удалений данные копии
+        // совпадают с исходными, и метка переносится, чтобы кэши по ней оставались действительными
+        if (other.removed_stops_.empty() && other.removed_buses_.empty()) {
+            version_ = other.version_;
+        }
+    }
+
+    TransportCatalogue::TransportCatalogue(const TransportCatalogue& other, std::shared_ptr<NamePool> names)
+        : names_(std::move(names)) {
+        CopyFrom(other, other.removed_stops_, other.removed_buses_);
+        if (other.removed_stops_.empty() && other.removed_buses_.empty()) {
+            version_ = other.version_;
+        }
+    }
+
+    TransportCatalogue& TransportCatalogue::operator=(const TransportCatalogue& other) {
+        if (this != &other) {
+            TransportCatalogue copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    void TransportCatalogue::CopyFrom(const TransportCatalogue& other,
+                                      const std::unordered_set<const domain::Stop*>& skip_stops,
+                                      const std::unordered_set<const domain::Bus*>& skip_buses) {
+        // Имена из общего пула уже на месте, в другой пул они копируются
+        const bool same_pool = names_ == other.names_;
+        const auto keep_name = [this, same_pool](std::string_view name) {
+            return same_pool ? name : names_->Intern(name);
+        };
+
+        // Соответствие старых указателей новым (имена остановок могут повторяться)
+        std::unordered_map<const domain::Stop*, const domain::Stop*> stop_map;
+        stop_map.reserve(other.stops_.size());
+        for (const auto& stop : other.stops_) {
+            if (skip_stops.count(&stop)) continue;
+            IndexStop(stops_.emplace_back(domain::Stop{ keep_name(stop.name), stop.coordinates }));
+            stop_map[&stop] = &stops_.back();
+        }
+
+        distances_.reserve(other.distances_.size());
+        for (const auto& [stops, distance] : other.distances_) {
+            if (skip_stops.count(stops.first) || skip_stops.count(stops.second)) continue;
+            SetDistance(stop_map.at(stops.first), stop_map.at(stops.second), distance);
+        }
+
+        for (const auto& bus : other.buses_) {
+            if (skip_buses.count(&bus)) continue;
+            domain::Bus copy{ keep_name(bus.name), {}, bus.is_roundtrip };
+            copy.stops.reserve(bus.stops.size());
+            for (const domain::Stop* stop : bus.stops) {
+                if (skip_stops.count(stop)) continue;
+                copy.stops.push_back(stop_map.at(stop));
+            }
+            IndexBus(buses_.emplace_back(std::move(copy)));
+        }
+    }
+
     void TransportCatalogue::AddStop(const domain::Stop& stop) {
-        stops_.push_back(stop);
-        const auto& stop_ref = stops_.back();
-        stop_name_to_stop_[stop_ref.name] = &stop_ref;
-        stop_to_buses_[stop_ref.name];
+        IndexStop(stops_.emplace_back(domain::Stop{ names_->Intern(stop.name), stop.coordinates }));
     }
 
     void TransportCatalogue::AddBus(const domain::Bus& bus) {
-        buses_.push_back(bus);
-        auto& bus_ref = buses_.back();
-        bus_name_to_bus_[bus_ref.name] = &bus_ref;
+        auto& bus_ref = buses_.emplace_back(bus);
+        bus_ref.name = names_->Intern(bus.name);
+        IndexBus(bus_ref);
+    }
+
+    void TransportCatalogue::IndexStop(domain::Stop& stop) {
+        stop_name_to_stop_[stop.name] = &stop;
+        stop_to_buses_[stop.name];
+        version_.Touch();
+    }
+
+    void TransportCatalogue::IndexBus(domain::Bus& bus) {
+        bus_name_to_bus_[bus.name] = &bus;
+        AddBusToStops(bus);
+        version_.Touch();
+    }
+
+    void TransportCatalogue::AddBusToStops(const domain::Bus& bus) {
+        const std::string_view bus_name = bus.name;
+        for (const auto stop : bus.stops) {
+            auto& buses = stop_to_buses_[stop->name];
+            auto it = std::lower_bound(buses.begin(), buses.end(), bus_name);
+            if (it == buses.end() || *it != bus_name) {
+                buses.insert(it, bus_name);
+            }
+        }
+    }
+
+    void TransportCatalogue::RemoveBusFromStops(const domain::Bus& bus) {
+        const std::string_view bus_name = bus.name;
+        for (const auto stop : bus.stops) {
+            auto& buses = stop_to_buses_[stop->name];
+            auto it = std::lower_bound(buses.begin(), buses.end(), bus_name);
+            if (it != buses.end() && *it == bus_name) {
+                buses.erase(it);
+            }
+        }
+    }
+
+    bool TransportCatalogue::UpdateStop(std::string_view name, geo::Coordinates coordinates) {
+        auto it = stop_name_to_stop_.find(name);
+        if (it == stop_name_to_stop_.end()) {
+            return false;
+        }
+        it->second->coordinates = coordinates;
+        version_.Touch();
+        return true;
+    }
+
+    bool TransportCatalogue::UpdateBus(std::string_view name, std::vector<const domain::Stop*> stops, bool is_roundtrip) {
+        auto it = bus_name_to_bus_.find(name);
+        if (it == bus_name_to_bus_.end()) {
+            return false;
+        }
+        domain::Bus& bus = *it->second;
+        RemoveBusFromStops(bus);
+        bus.stops = std::move(stops);
+        bus.is_roundtrip = is_roundtrip;
+        AddBusToStops(bus);
+        version_.Touch();
+        return true;
+    }
+
+    bool TransportCatalogue::RemoveStop(std::string_view name) {
+        return Remove({ name }, {}) > 0;
+    }
+
+    bool TransportCatalogue::RemoveBus(std::string_view name) {
+        return Remove({}, { name }) > 0;
+    }
+
+    size_t TransportCatalogue::Remove(const std::vector<std::string_view>& stop_names,
+                                      const std::vector<std::string_view>& bus_names) {
+        size_t removed = 0;
+        for (const std::string_view name : stop_names) {
+            removed += MarkStopRemoved(name);
+        }
+        for (const std::string_view name : bus_names) {
+            removed += MarkBusRemoved(name);
+        }
+        Compact();
+        return removed;
+    }
+
+    bool TransportCatalogue::MarkStopRemoved(std::string_view name) {
+        auto it = stop_name_to_stop_.find(name);
+        if (it == stop_name_to_stop_.end()) {
+            return false;
+        }
+        const domain::Stop* stop = it->second;
+        // Маршруты теряют остановку так же, как при перестроении
+        if (auto buses = stop_to_buses_.find(stop->name); buses != stop_to_buses_.end()) {
+            for (const std::string_view bus_name : buses->second) {
+                auto& stops = bus_name_to_bus_.at(bus_name)->stops;
+                stops.erase(std::remove(stops.begin(), stops.end(), stop), stops.end());
+            }
+            stop_to_buses_.erase(buses);
+        }
+        stop_name_to_stop_.erase(it);
+        removed_stops_.insert(stop);
+        version_.Touch();
+        return true;
+    }
+
+    bool TransportCatalogue::MarkBusRemoved(std::string_view name) {
+        auto it = bus_name_to_bus_.find(name);
+        if (it == bus_name_to_bus_.end()) {
+            return false;
+        }
+        const domain::Bus* bus = it->second;
+        RemoveBusFromStops(*bus);
+        bus_name_to_bus_.erase(it);
+        removed_buses_.insert(bus);
+        version_.Touch();
+        return true;
+    }
 
-        for (const auto stop : bus_ref.stops) {
-            stop_to_buses_[stop->name].insert(bus_ref.name);
+    void TransportCatalogue::Compact() {
+        if (removed_stops_.empty() && removed_buses_.empty()) {
+            return;
         }
+        TransportCatalogue rest(names_);
+        rest.CopyFrom(*this, removed_stops_, removed_buses_);
+        *this = std::move(rest);
+    }
+
+    bool TransportCatalogue::RemoveDistance(const domain::Stop* from, const domain::Stop* to) {
+        if (distances_.erase({ from, to }) == 0) {
+            return false;
+        }
+        version_.Touch();
+        return true;
     }
 
     const domain::Bus* TransportCatalogue::FindBus(std::string_view name) const {
@@ -37,6 +235,7 @@ namespace transport_catalogue {
 
     void TransportCatalogue::SetDistance(const domain::Stop* from, const domain::Stop* to, int distance) {
         distances_[{from, to}] = distance;
+        version_.Touch();
     }
 
     int TransportCatalogue::GetDistance(const domain::Stop* from, const domain::Stop* to) const {
@@ -57,6 +256,10 @@ namespace transport_catalogue {
         return stops_;
     }
 
+    const DistanceMap& TransportCatalogue::GetAllDistances() const {
+        return distances_;
+    }
+
     std::optional<BusInfo> TransportCatalogue::GetBusInfo(std::string_view bus_name) const {
         const domain::Bus* bus = FindBus(bus_name);
         if (!bus || bus->stops.empty()) {
@@ -106,13 +309,36 @@ namespace transport_catalogue {
         return info;
     }
 
-    const std::unordered_set<std::string_view>& TransportCatalogue::GetBusesForStop(std::string_view stop_name) const {
-        static const std::unordered_set<std::string_view> empty_result;
+    const std::vector<std::string_view>& TransportCatalogue::GetBusesForStop(std::string_view stop_name) const {
+        static const std::vector<std::string_view> empty_result;
         if (auto it = stop_to_buses_.find(stop_name); it != stop_to_buses_.end()) {
             return it->second;
         }
         return empty_result;
     }
 
-} // namespace transport_catalogue
+    memory_stats::Report TransportCatalogue::GetMemoryStats() const {
+        using namespace memory_stats;
 
+        Entry buses{ "catalogue.buses", buses_.size(), DequeBytes(buses_) };
+        for (const auto& bus : buses_) {
+            buses.bytes += VectorBytes(bus.stops);
+        }
+
+        Entry stop_buses{ "catalogue.stop_buses", stop_to_buses_.size(), HashMapBytes(stop_to_buses_) };
+        for (const auto& [name, bus_names] : stop_to_buses_) {
+            stop_buses.bytes += VectorBytes(bus_names);
+        }
+
+        return {
+            { "catalogue.names", names_->GetSize(), names_->GetMemoryUsage() },
+            { "catalogue.stops", stops_.size(), DequeBytes(stops_) },
+            std::move(buses),
+            { "catalogue.stop_index", stop_name_to_stop_.size(), HashMapBytes(stop_name_to_stop_) },
+            { "catalogue.bus_index", bus_name_to_bus_.size(), HashMapBytes(bus_name_to_bus_) },
+            std::move(stop_buses),
+            { "catalogue.distances", distances_.size(), HashMapBytes(distances_) },
+        };
+    }
+
+} // namespace transport_catalogue
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -9,6 +11,8 @@
 #include <vector>
 #include "domain.h"
 #include "geo.h"
+#include "memory_stats.h"
+#include "name_pool.h"
 
 namespace transport_catalogue {
 
@@ -27,30 +31,128 @@ namespace transport_catalogue {
         }
     };
 
+    class BulkLoader;
+
+    // Метка версии данных каталога. Значения берутся из общего для процесса счётчика,
+    // поэтому не повторяются ни между изменениями, ни между разными каталогами.
+    // Копия сохраняет метку (данные те же), а перемещённый объект получает новую.
+    // Копия TransportCatalogue сохраняет метку, если у исходного каталога нет отложенных удалений
+    class VersionStamp {
+    public:
+        VersionStamp() : value_(Next()) {}
+        VersionStamp(const VersionStamp&) = default;
+        VersionStamp& operator=(const VersionStamp&) = default;
+        VersionStamp(VersionStamp&& other) noexcept : value_(other.value_) {
+            other.Touch();
+        }
+        VersionStamp& operator=(VersionStamp&& other) noexcept {
+            if (this != &other) {
+                value_ = other.value_;
+                other.Touch();
+            }
+            return *this;
+        }
+
+        uint64_t Get() const { return value_; }
+        void Touch() { value_ = Next(); }
+
+    private:
+        static uint64_t Next();
+
+        uint64_t value_;
+    };
+
+    using DistanceMap = std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, PairPointersHasher>;
+
     class TransportCatalogue {
     public:
+        TransportCatalogue();
+        // Имена объектов хранятся в names; пул можно разделить с другими каталогами
+        explicit TransportCatalogue(std::shared_ptr<NamePool> names);
+        // Копирование перестраивает все указатели и индексы на новые объекты, а пул имён разделяет:
+        // имена не копируются, копия ссылается на те же строки
+        TransportCatalogue(const TransportCatalogue& other);
+        // Копия с именами в другом пуле, например чтобы избавиться от имён удалённых объектов
+        TransportCatalogue(const TransportCatalogue& other, std::shared_ptr<NamePool> names);
+        TransportCatalogue& operator=(const TransportCatalogue& other);
+        TransportCatalogue(TransportCatalogue&&) = default;
+        TransportCatalogue& operator=(TransportCatalogue&&) = default;
+
+        // Имя копируется в пул имён каталога
         void AddStop(const domain::Stop& stop);
         void AddBus(const domain::Bus& bus);
 
+        // Изменение уже загруженных данных. Возвращают false, если объект не найден
+        bool UpdateStop(std::string_view name, geo::Coordinates coordinates);
+        bool UpdateBus(std::string_view name, std::vector<const domain::Stop*> stops, bool is_roundtrip);
+        // Удаление перестраивает каталог целиком, так как сдвигает объекты в deque.
+        // Остановка удаляется также из маршрутов и из таблицы расстояний
+        bool RemoveStop(std::string_view name);
+        bool RemoveBus(std::string_view name);
+        // Удаляет несколько остановок и автобусов за одно перестроение.
+        // Возвращает число найденных и удалённых объектов
+        size_t Remove(const std::vector<std::string_view>& stop_names, const std::vector<std::string_view>& bus_names);
+
+        // Отложенное удаление: объект сразу пропадает из поиска по имени, из маршрутов
+        // и из списков автобусов, а место в deque и его расстояния освобождает Compact().
+        // Стоит пропорционально числу связанных с объектом маршрутов, а не размеру каталога.
+        // До Compact() GetAllStops(), GetAllBuses() и GetAllDistances() ещё содержат удалённое
+        bool MarkStopRemoved(std::string_view name);
+        bool MarkBusRemoved(std::string_view name);
+        // Перестраивает каталог без помеченных объектов; без них ничего не делает
+        void Compact();
+        bool RemoveDistance(const domain::Stop* from, const domain::Stop* to);
+
         const domain::Bus* FindBus(std::string_view name) const;
         const domain::Stop* FindStop(std::string_view name) const;
 
         std::optional<BusInfo> GetBusInfo(std::string_view bus_name) const;
-        const std::unordered_set<std::string_view>& GetBusesForStop(std::string_view stop_name) const;
+        // Имена автобусов, проходящих через остановку, в лексикографическом порядке
+        const std::vector<std::string_view>& GetBusesForStop(std::string_view stop_name) const;
 
         void SetDistance(const domain::Stop* from, const domain::Stop* to, int distance);
         int GetDistance(const domain::Stop* from, const domain::Stop* to) const;
 
         const std::deque<domain::Bus>& GetAllBuses() const;
         const std::deque<domain::Stop>& GetAllStops() const;
+        // Только явно заданные дорожные расстояния
+        const DistanceMap& GetAllDistances() const;
+
+        const std::shared_ptr<NamePool>& GetNamePool() const { return names_; }
+
+        // Память основных контейнеров каталога
+        memory_stats::Report GetMemoryStats() const;
+
+        // Меняется при каждом изменении данных; по ней сбрасываются кэши,
+        // построенные по каталогу
+        uint64_t GetVersion() const { return version_.Get(); }
 
     private:
+        friend class BulkLoader;
+
+        // Копирует other, пропуская остановки skip_stops и автобусы skip_buses
+        void CopyFrom(const TransportCatalogue& other,
+                      const std::unordered_set<const domain::Stop*>& skip_stops,
+                      const std::unordered_set<const domain::Bus*>& skip_buses);
+        // Добавляют в индексы объект, уже лежащий в stops_ или buses_, с именем из names_
+        void IndexStop(domain::Stop& stop);
+        void IndexBus(domain::Bus& bus);
+        void AddBusToStops(const domain::Bus& bus);
+        void RemoveBusFromStops(const domain::Bus& bus);
+
+        std::shared_ptr<NamePool> names_;
         std::deque<domain::Stop> stops_;
         std::deque<domain::Bus> buses_;
-        std::unordered_map<std::string_view, const domain::Stop*> stop_name_to_stop_;
-        std::unordered_map<std::string_view, const domain::Bus*> bus_name_to_bus_;
-        std::unordered_map<std::string_view, std::unordered_set<std::string_view>> stop_to_buses_;
-        std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, PairPointersHasher> distances_;
+        std::unordered_map<std::string_view, domain::Stop*> stop_name_to_stop_;
+        std::unordered_map<std::string_view, domain::Bus*> bus_name_to_bus_;
+        // Для каждой остановки хранится отсортированный список автобусов без повторов,
+        // поэтому ответ на запрос Stop не требует ни копирования, ни сортировки
+        std::unordered_map<std::string_view, std::vector<std::string_view>> stop_to_buses_;
+        DistanceMap distances_;
+        // Помеченные на удаление, ждут Compact()
+        std::unordered_set<const domain::Stop*> removed_stops_;
+        std::unordered_set<const domain::Bus*> removed_buses_;
+        VersionStamp version_;
     };
 
 } // namespace transport_catalogue
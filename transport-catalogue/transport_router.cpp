@@ -56,7 +56,7 @@ void TransportRouter::AddTripEdges() {
     }
 }
 
-void TransportRouter::AddTripEdgesForRange(const std::vector<const domain::Stop*>& stops, const std::string& bus_name) {
+void TransportRouter::AddTripEdgesForRange(const std::vector<const domain::Stop*>& stops, std::string_view bus_name) {
     constexpr double PENALTY_PER_STOP = 1e-3;    // мягкий штраф за раннюю пересадку, чтобы при прочих равных ехать на одном маршруте до упора
 
     for (size_t i = 0; i + 1 < stops.size(); ++i) {
@@ -107,7 +107,7 @@ std::optional<TransportRouter::RouteResult> TransportRouter::BuildRoute(std::str
         if (info.bus_name.empty()) {
             result.items.push_back({                // Ожидание
                 "Wait",
-                vertex_to_stop_.at(edge.from)->name,
+                std::string(vertex_to_stop_.at(edge.from)->name),
                 edge.weight,
                 0
             });
@@ -125,3 +125,19 @@ std::optional<TransportRouter::RouteResult> TransportRouter::BuildRoute(std::str
 
     return result;
 }
+
+memory_stats::Report TransportRouter::GetMemoryStats() const {
+    using namespace memory_stats;
+
+    Entry edge_info{ "router.edge_info", edge_info_.size(), HashMapBytes(edge_info_) };
+    for (const auto& [id, info] : edge_info_) {
+        edge_info.bytes += StringBytes(info.bus_name);
+    }
+
+    return {
+        { "router.graph", graph_.GetEdgeCount(), graph_.GetMemoryUsage() },
+        { "router.vertices", vertex_to_stop_.size(), HashMapBytes(stop_to_vertex_) + VectorBytes(vertex_to_stop_) },
+        std::move(edge_info),
+        { "router.routes", graph_.GetVertexCount() * graph_.GetVertexCount(), router_ ? router_->GetMemoryUsage() : 0 },
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "graph.h"
+#include "memory_stats.h"
 #include "router.h"
 #include "transport_catalogue.h"
 
@@ -33,6 +34,9 @@ public:
 
     std::optional<RouteResult> BuildRoute(std::string_view from, std::string_view to) const;
 
+    // Память графа, таблицы маршрутов graph::Router и вспомогательных индексов
+    memory_stats::Report GetMemoryStats() const;
+
 private:
     static constexpr double KMH_TO_M_PER_MIN = 1000.0 / 60.0;
 
@@ -43,7 +47,7 @@ private:
     void InitVertices();
     void AddWaitEdges();
     void AddTripEdges();
-    void AddTripEdgesForRange(const std::vector<const domain::Stop*>& stops, const std::string& bus_name);
+    void AddTripEdgesForRange(const std::vector<const domain::Stop*>& stops, std::string_view bus_name);
     void AddEdge(graph::VertexId from, graph::VertexId to, double weight, std::string_view bus_name, int span_count, double real_time);
 
     const transport_catalogue::TransportCatalogue& db_;